@@ -1,22 +1,91 @@
 #pragma once
 
+// JSON_DTO_64BIT_SIZES makes rapidjson use 64-bit string and container lengths, so values over 4 GiB can be loaded and dumped.
+// It must be defined the same way in every translation unit, and json_dto.h must be included before any rapidjson header.
+#if defined(JSON_DTO_64BIT_SIZES)
+#include <cstddef>
+#define RAPIDJSON_NO_SIZETYPEDEFINE
+#include <rapidjson/rapidjson.h>
+RAPIDJSON_NAMESPACE_BEGIN
+typedef ::std::size_t SizeType;
+RAPIDJSON_NAMESPACE_END
+#endif
+
+// JSON_DTO_RAPIDJSON_SIMD turns on rapidjson's vectorized whitespace skipping and string scanning for the best
+// instruction set the target allows. It is opt-in: the vector loads may read up to 15 bytes past the end of the input
+// (never across a page), and every translation unit including rapidjson must agree on it. The vector paths cover
+// null-terminated input: loads() of a std::string and the in-situ parsing of load_files. Other input, e.g. a
+// std::string_view, is not null-terminated and is read through MemoryStream, which they do not cover.
+#if defined(JSON_DTO_RAPIDJSON_SIMD) && !defined(RAPIDJSON_SSE2) && !defined(RAPIDJSON_SSE42) && !defined(RAPIDJSON_NEON)
+#if defined(__SSE4_2__)
+#define RAPIDJSON_SSE42
+#elif defined(__SSE2__)
+#define RAPIDJSON_SSE2
+#elif defined(__ARM_NEON)
+#define RAPIDJSON_NEON
+#endif
+#endif
+
 #include <rapidjson/document.h>
 #include <rapidjson/istreamwrapper.h>
+#include <rapidjson/memorystream.h>
 #include <rapidjson/ostreamwrapper.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/error/en.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <chrono>
 #include <concepts>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <sstream>
+#include <stdexcept>
+#include <stop_token>
 #include <string_view>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <variant>
+#include <version>
+
+#if __has_include(<format>)
+#include <format>
+#endif
+#if __has_include(<fmt/format.h>) && !defined(JSON_DTO_NO_FMT)
+#include <fmt/format.h>
+#endif
+#if !defined(JSON_DTO_NO_SIMD) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define JSON_DTO_HAS_X86_DISPATCH 1
+#elif !defined(JSON_DTO_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define JSON_DTO_HAS_NEON 1
+#endif
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#define JSON_DTO_HAS_MMAN 1
+#endif
+
+// Marks error paths: never inlined into their callers and placed away from the hot code
+#if defined(_MSC_VER) && !defined(__clang__)
+#define JSON_DTO_COLD __declspec(noinline)
+#else
+#define JSON_DTO_COLD [[gnu::cold, gnu::noinline]]
+#endif
 
 namespace json_dto
 {
@@ -32,9 +101,475 @@ public:
         ss << "Parse error: " << pr.Code() << "(" << GetParseError(pr.Code()) << "), at " << pr.Offset();
         _reason = ss.str();
     }
+    void add_location(const std::string& location) { _reason += " at " + location; }
     [[nodiscard]] char const* what() const noexcept override { return _reason.c_str(); }
 };
 
+class cancelled_exception : public std::exception
+{
+public:
+    enum class reason { stop_requested, deadline_exceeded, byte_budget_exceeded };
+    explicit cancelled_exception(reason r) : _reason(r) {}
+    reason why() const { return _reason; }
+    [[nodiscard]] char const* what() const noexcept override
+    {
+        switch (_reason)
+        {
+        case reason::stop_requested:
+            return "Cancelled: stop requested";
+        case reason::deadline_exceeded:
+            return "Cancelled: deadline exceeded";
+        default:
+            return "Cancelled: byte budget exceeded";
+        }
+    }
+private:
+    reason _reason;
+};
+
+// Limits of one load or dump call, checked at container boundaries.
+// max_bytes limits the input consumed by parsing or the output produced by writing.
+struct cancellation
+{
+    std::stop_token stop;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    size_t max_bytes = std::numeric_limits<size_t>::max();
+
+    std::optional<cancelled_exception::reason> expired(size_t bytes) const
+    {
+        if (stop.stop_requested())
+            return cancelled_exception::reason::stop_requested;
+        if (bytes > max_bytes)
+            return cancelled_exception::reason::byte_budget_exceeded;
+        if (deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() > deadline)
+            return cancelled_exception::reason::deadline_exceeded;
+        return std::nullopt;
+    }
+};
+
+// Options of to_value, dump and dumps
+struct write_options
+{
+    // Overwrite the members the target object already has instead of appending duplicates, reusing array storage
+    bool update = false;
+    // Reference strings and field names of the DTO instead of copying them; the DTO must outlive the value unchanged
+    bool borrow_strings = false;
+    // Byte-stable output for equal values: unordered maps in key order, no negative zero, floats in shortest form
+    bool canonical = false;
+    // Compact profile: leave out members which are null or empty containers; load it with load_options::omit_empty
+    bool omit_empty = false;
+};
+
+// Options of from_value, loads, load and validate
+struct load_options
+{
+    // Compact profile: take the absent members which write_options::omit_empty leaves out as null or empty,
+    // instead of failing with "Field not found"
+    bool omit_empty = false;
+};
+
+namespace detail
+{
+// Lengths beyond rapidjson::SizeType are an error rather than silently truncated
+inline rapidjson::SizeType checked_size(size_t size)
+{
+    if (size > std::numeric_limits<rapidjson::SizeType>::max())
+        throw std::length_error("Length " + std::to_string(size) + " exceeds rapidjson::SizeType, build with JSON_DTO_64BIT_SIZES");
+    return (rapidjson::SizeType)size;
+}
+
+// Limits of the load or dump call running on this thread, if it has any
+inline thread_local const cancellation* current_cancellation = nullptr;
+
+inline void check_cancellation()
+{
+    if (const auto* c = current_cancellation)
+        if (const auto r = c->expired(0))
+            throw cancelled_exception(*r);
+}
+
+class cancellation_scope
+{
+    const cancellation* _previous;
+public:
+    explicit cancellation_scope(const cancellation& c) : _previous(std::exchange(current_cancellation, &c)) {}
+    cancellation_scope(const cancellation_scope&) = delete;
+    cancellation_scope& operator=(const cancellation_scope&) = delete;
+    ~cancellation_scope() { current_cancellation = _previous; }
+};
+
+// Options of the to_value call running on this thread, if any
+inline thread_local const write_options* current_write_options = nullptr;
+
+inline const write_options& active_write_options()
+{
+    static constexpr write_options defaults;
+    return current_write_options ? *current_write_options : defaults;
+}
+
+class write_options_scope
+{
+    const write_options* _previous;
+public:
+    explicit write_options_scope(const write_options& o) : _previous(std::exchange(current_write_options, &o)) {}
+    write_options_scope(const write_options_scope&) = delete;
+    write_options_scope& operator=(const write_options_scope&) = delete;
+    ~write_options_scope() { current_write_options = _previous; }
+};
+
+// Options of the load running on this thread, if any
+inline thread_local const load_options* current_load_options = nullptr;
+
+inline const load_options& active_load_options()
+{
+    static constexpr load_options defaults;
+    return current_load_options ? *current_load_options : defaults;
+}
+
+class load_options_scope
+{
+    const load_options* _previous;
+public:
+    explicit load_options_scope(const load_options& o) : _previous(std::exchange(current_load_options, &o)) {}
+    load_options_scope(const load_options_scope&) = delete;
+    load_options_scope& operator=(const load_options_scope&) = delete;
+    ~load_options_scope() { current_load_options = _previous; }
+};
+
+// Path to the value which failed to convert, filled innermost first while the failure propagates,
+// so successful conversions never touch it
+struct error_path
+{
+    struct segment
+    {
+        const char* name = nullptr;
+        size_t length = 0;
+        size_t index = 0;
+        segment() = default;
+        segment(size_t i) : index(i) {}
+        segment(const char* n) : name(n), length(std::string_view::npos) {}
+        segment(const char* n, size_t len) : name(n), length(len) {}
+    };
+    static constexpr size_t capacity = 32;
+    std::array<segment, capacity> segments;
+    size_t size = 0;
+
+    void push(const segment& s)
+    {
+        if (size < capacity)
+            segments[size] = s;
+        ++size;
+    }
+    // JSON Pointer of the failed value; "/..." stands for the outer segments which did not fit
+    std::string pointer() const
+    {
+        std::string result = size > capacity ? "/..." : "";
+        for (size_t i = std::min(size, capacity); i-- > 0;)
+        {
+            result += '/';
+            const auto& s = segments[i];
+            if (!s.name)
+                result += std::to_string(s.index);
+            else
+                for (char c : s.length == std::string_view::npos ? std::string_view(s.name) : std::string_view(s.name, s.length))
+                    result += c == '~' ? "~0" : c == '/' ? "~1" : std::string(1, c);
+        }
+        return result;
+    }
+};
+inline thread_local error_path current_error_path;
+
+// Out of line, so the field accessors of every DTO do not carry their own copy of the message formatting
+[[noreturn]] JSON_DTO_COLD inline void throw_field_not_found(const char* name, const char* type_name)
+{
+    throw parse_exception(std::string("Field not found: ") + name + " in type " + (type_name ? type_name : ""));
+}
+[[noreturn]] JSON_DTO_COLD inline void throw_cannot_parse(const char* name, const char* type_name)
+{
+    throw parse_exception(std::string("Cannot parse field: ") + name + " in type " + (type_name ? type_name : ""));
+}
+
+// Structural scanning of serialized JSON: finds value boundaries without parsing or validating the values
+inline size_t skip_ws(std::string_view s, size_t pos)
+{
+    while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r'))
+        ++pos;
+    return pos;
+}
+
+// pos is at the opening quote, returns the position after the closing quote
+inline size_t skip_string(std::string_view s, size_t pos)
+{
+    for (++pos;;)
+    {
+        pos = s.find_first_of("\"\\", pos);
+        if (pos == std::string_view::npos)
+            throw parse_exception("Unterminated string");
+        if (s[pos] == '"')
+            return pos + 1;
+        pos += 2;
+    }
+}
+
+// pos is at the first character of a value, returns the position after its last character
+inline size_t skip_value(std::string_view s, size_t pos)
+{
+    if (pos >= s.size())
+        throw parse_exception("Unexpected end of input");
+    if (s[pos] == '"')
+        return skip_string(s, pos);
+    if (s[pos] == '{' || s[pos] == '[')
+    {
+        size_t depth = 0;
+        while (pos < s.size())
+        {
+            switch (s[pos])
+            {
+            case '"':
+                pos = skip_string(s, pos);
+                continue;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0)
+                    return pos + 1;
+                break;
+            }
+            ++pos;
+        }
+        throw parse_exception("Unexpected end of input");
+    }
+    const size_t end = s.find_first_of(" \t\r\n,]}", pos);
+    if (end == pos)
+        throw parse_exception("Unexpected character at offset " + std::to_string(pos));
+    return end == std::string_view::npos ? s.size() : end;
+}
+
+inline uint32_t unescape_hex4(std::string_view raw, size_t pos)
+{
+    if (pos + 4 > raw.size())
+        throw parse_exception("Invalid unicode escape");
+    uint32_t cp = 0;
+    for (size_t i = pos; i < pos + 4; ++i)
+    {
+        const char c = raw[i];
+        cp <<= 4;
+        if (c >= '0' && c <= '9')
+            cp |= (uint32_t)(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            cp |= (uint32_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            cp |= (uint32_t)(c - 'A' + 10);
+        else
+            throw parse_exception("Invalid unicode escape");
+    }
+    return cp;
+}
+
+// Appends the contents of a string value, raw is the text between the quotes
+inline void append_unescaped(std::string& out, std::string_view raw)
+{
+    for (size_t pos = 0; pos < raw.size();)
+    {
+        const size_t escape = raw.find('\\', pos);
+        out.append(raw.substr(pos, escape - pos));
+        if (escape == std::string_view::npos)
+            return;
+        if (escape + 1 >= raw.size())
+            throw parse_exception("Invalid escape");
+        pos = escape + 2;
+        switch (raw[escape + 1])
+        {
+        case '"': out += '"'; continue;
+        case '\\': out += '\\'; continue;
+        case '/': out += '/'; continue;
+        case 'b': out += '\b'; continue;
+        case 'f': out += '\f'; continue;
+        case 'n': out += '\n'; continue;
+        case 'r': out += '\r'; continue;
+        case 't': out += '\t'; continue;
+        case 'u': break;
+        default: throw parse_exception("Invalid escape");
+        }
+        uint32_t cp = unescape_hex4(raw, pos);
+        pos += 4;
+        if (cp >= 0xD800 && cp <= 0xDBFF)
+        {
+            if (raw.substr(pos, 2) != "\\u")
+                throw parse_exception("Unpaired surrogate");
+            const uint32_t low = unescape_hex4(raw, pos + 2);
+            if (low < 0xDC00 || low > 0xDFFF)
+                throw parse_exception("Unpaired surrogate");
+            pos += 6;
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        else if (cp >= 0xDC00 && cp <= 0xDFFF)
+            throw parse_exception("Unpaired surrogate");
+        if (cp < 0x80)
+            out += (char)cp;
+        else if (cp < 0x800)
+        {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+}
+
+// Compares the contents of a string value with name; only keys with escapes are unescaped
+inline bool key_equals(std::string_view raw, std::string_view name)
+{
+    if (raw.find('\\') == std::string_view::npos)
+        return raw == name;
+    std::string key;
+    append_unescaped(key, raw);
+    return key == name;
+}
+
+// Finds the value of a member of the object which starts at pos, returns the beginning of the value.
+// Only the members before it are skipped; the value itself is not scanned.
+inline std::optional<size_t> find_member(std::string_view s, size_t pos, std::string_view name)
+{
+    pos = skip_ws(s, pos);
+    if (pos >= s.size() || s[pos] != '{')
+        return std::nullopt;
+    pos = skip_ws(s, pos + 1);
+    if (pos < s.size() && s[pos] == '}')
+        return std::nullopt;
+    for (;;)
+    {
+        if (pos >= s.size() || s[pos] != '"')
+            throw parse_exception("Malformed object at offset " + std::to_string(pos));
+        const size_t key_end = skip_string(s, pos);
+        const auto key = s.substr(pos + 1, key_end - pos - 2);
+        pos = skip_ws(s, key_end);
+        if (pos >= s.size() || s[pos] != ':')
+            throw parse_exception("Malformed object at offset " + std::to_string(pos));
+        const size_t value_begin = skip_ws(s, pos + 1);
+        if (key_equals(key, name))
+            return value_begin;
+        pos = skip_ws(s, skip_value(s, value_begin));
+        if (pos < s.size() && s[pos] == ',')
+            pos = skip_ws(s, pos + 1);
+        else if (pos < s.size() && s[pos] == '}')
+            return std::nullopt;
+        else
+            throw parse_exception("Malformed object at offset " + std::to_string(pos));
+    }
+}
+
+// Finds an element of the array which starts at pos, returns the beginning of the element
+inline std::optional<size_t> find_element(std::string_view s, size_t pos, size_t index)
+{
+    pos = skip_ws(s, pos);
+    if (pos >= s.size() || s[pos] != '[')
+        return std::nullopt;
+    pos = skip_ws(s, pos + 1);
+    if (pos < s.size() && s[pos] == ']')
+        return std::nullopt;
+    for (size_t i = 0;; ++i)
+    {
+        if (i == index)
+            return pos;
+        pos = skip_ws(s, skip_value(s, pos));
+        if (pos < s.size() && s[pos] == ',')
+            pos = skip_ws(s, pos + 1);
+        else if (pos < s.size() && s[pos] == ']')
+            return std::nullopt;
+        else
+            throw parse_exception("Malformed array at offset " + std::to_string(pos));
+    }
+}
+
+// Array index of a JSON Pointer token: digits without leading zeros
+inline size_t pointer_index(std::string_view token, std::string_view pointer)
+{
+    if (token.empty() || (token.size() > 1 && token.front() == '0'))
+        throw parse_exception("Invalid array index in JSON pointer: " + std::string(pointer));
+    size_t index = 0;
+    for (char c : token)
+    {
+        if (c < '0' || c > '9')
+            throw parse_exception("Invalid array index in JSON pointer: " + std::string(pointer));
+        if (index > (std::numeric_limits<size_t>::max() - (size_t)(c - '0')) / 10)
+            throw parse_exception("Array index out of range in JSON pointer: " + std::string(pointer));
+        index = index * 10 + (size_t)(c - '0');
+    }
+    return index;
+}
+
+// Finds the value addressed by a JSON Pointer (RFC 6901), returns [begin, end) of the value.
+// The text is scanned once, up to the end of that value: the path descends into the containers
+// on the way and skips only their members before it.
+inline std::pair<size_t, size_t> locate(std::string_view s, std::string_view pointer)
+{
+    size_t begin = skip_ws(s, 0);
+    if (!pointer.empty() && pointer.front() != '/')
+        throw parse_exception("Invalid JSON pointer: " + std::string(pointer));
+    for (size_t pos = 1; pos <= pointer.size();)
+    {
+        size_t next = pointer.find('/', pos);
+        if (next == std::string_view::npos)
+            next = pointer.size();
+        std::string token;
+        for (size_t i = pos; i < next; ++i)
+        {
+            if (pointer[i] == '~' && i + 1 < next && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+                token += pointer[++i] == '0' ? '~' : '/';
+            else
+                token += pointer[i];
+        }
+        std::optional<size_t> found;
+        if (begin < s.size() && s[begin] == '{')
+            found = find_member(s, begin, token);
+        else if (begin < s.size() && s[begin] == '[')
+            found = find_element(s, begin, pointer_index(token, pointer));
+        if (!found)
+            throw parse_exception("Path not found: " + std::string(pointer));
+        begin = *found;
+        pos = next + 1;
+    }
+    return { begin, skip_value(s, begin) };
+}
+
+// Describes where the current error path points to, with line and column when the source text is known
+inline std::string error_location(std::string_view text)
+{
+    std::string result = current_error_path.pointer();
+    if (text.empty() || current_error_path.size > error_path::capacity)
+        return result;
+    try
+    {
+        const size_t offset = locate(text, result).first;
+        const size_t line_begin = text.rfind('\n', offset);
+        const size_t line = 1 + (size_t)std::count(text.begin(), text.begin() + offset, '\n');
+        const size_t column = line_begin == std::string_view::npos ? offset + 1 : offset - line_begin;
+        if (!result.empty())
+            result += ", ";
+        result += "line " + std::to_string(line) + ", column " + std::to_string(column);
+    }
+    catch (const parse_exception&)
+    {
+    }
+    return result;
+}
+}
+
 using value_r = rapidjson::Value&;
 using value_c = const rapidjson::Value&;
 using allocator = rapidjson::MemoryPoolAllocator<>;
@@ -75,6 +610,16 @@ class json_writer
 {
     rapidjson::Value& _v;
     allocator& _a;
+    const write_options& _options = detail::active_write_options();
+
+    template<class T>
+    void write_member(const char* name, const T& value);
+    // A member omitted as default must not keep a stale value in the update target
+    void skip_member(const char* name)
+    {
+        if (_options.update)
+            _v.EraseMember(name);
+    }
 public:
     json_writer(rapidjson::Value& value, allocator& allocator) : _v{ value }, _a{ allocator } {}
     json_writer& operator()([[maybe_unused]] const char* name) { return *this; }
@@ -100,12 +645,14 @@ struct adapter
     {
         if (!v.IsObject())
             return false;
+        detail::check_cancellation();
         json_reader reader{ v };
         value.serialization(reader);
         return true;
     }
     static void set(allocator& a, value_r v, const T& value)
     {
+        detail::check_cancellation();
         if(!v.IsObject())
             v.SetObject();
         json_writer writer { v, a };
@@ -117,6 +664,27 @@ struct adapter
 template<class T>
 concept struct_like = std::is_same_v<void, typename adapter<T>::struct_like>;
 
+namespace detail
+{
+// Converts a part of a bigger value, recording segment on the error path if the conversion fails
+template<class T>
+bool get_traced(value_c v, T& value, const error_path::segment& segment)
+{
+    try
+    {
+        if (adapter<T>::get(v, value))
+            return true;
+    }
+    catch (const parse_exception&)
+    {
+        current_error_path.push(segment);
+        throw;
+    }
+    current_error_path.push(segment);
+    return false;
+}
+}
+
 #define ADAPTER(CPP_TYPE, TYPE) \
 template<> \
 struct adapter<CPP_TYPE> { \
@@ -131,24 +699,60 @@ ADAPTER(int, Int)
 ADAPTER(unsigned int, Uint)
 ADAPTER(int64_t, Int64)
 ADAPTER(uint64_t, Uint64)
-ADAPTER(float, Float)
-ADAPTER(double, Double)
 ADAPTER(bool, Bool)
 #undef ADAPTER
 
-template<>
-struct adapter<std::string>
+namespace detail
+{
+// Canonical form of floating point numbers: no negative zero, floats by their shortest decimal form
+inline double canonical_number(double value)
+{
+    return value == 0 ? 0.0 : value;
+}
+inline double canonical_number(float value)
+{
+    char buffer[32];
+    const auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    double result = 0;
+    std::from_chars(buffer, end, result);
+    return canonical_number(result);
+}
+}
+
+#define FLOATING_ADAPTER(CPP_TYPE, TYPE) \
+template<> \
+struct adapter<CPP_TYPE> { \
+static bool get(value_c v, CPP_TYPE& value) { \
+    if(!v.Is##TYPE ()) return false; \
+    value = (CPP_TYPE)v.Get##TYPE (); \
+    return true; \
+} \
+static void set([[maybe_unused]] allocator& a, value_r v, CPP_TYPE value) { \
+    if (detail::active_write_options().canonical) v.SetDouble(detail::canonical_number(value)); \
+    else v.Set##TYPE (value); \
+} };
+
+FLOATING_ADAPTER(float, Float)
+FLOATING_ADAPTER(double, Double)
+#undef FLOATING_ADAPTER
+
+template<class Alloc>
+struct adapter<std::basic_string<char, std::char_traits<char>, Alloc>>
 {
-    static bool get(value_c v, std::string& value)
+    using string = std::basic_string<char, std::char_traits<char>, Alloc>;
+    static bool get(value_c v, string& value)
     {
         if (!v.IsString())
             return false;
-        value = { v.GetString(), v.GetStringLength() };
+        value.assign(v.GetString(), v.GetStringLength());
         return true;
     }
-    static void set(allocator& a, value_r v, const std::string& value)
+    static void set(allocator& a, value_r v, const string& value)
     {
-        v.SetString(value.data(), (rapidjson::SizeType)value.size(), a);
+        if (detail::active_write_options().borrow_strings)
+            v.SetString(rapidjson::StringRef(value.data(), detail::checked_size(value.size())));
+        else
+            v.SetString(value.data(), detail::checked_size(value.size()), a);
     }
 };
 
@@ -192,7 +796,7 @@ struct adapter<BS>
         else
         {
             const auto str = value.to_string();
-            v.SetString(str.data(), (rapidjson::SizeType)str.size(), a);
+            v.SetString(str.data(), detail::checked_size(str.size()), a);
         }
     }
 };
@@ -228,11 +832,14 @@ struct adapter<std::variant<T...>>
     static bool load_one(const rapidjson::Value::ConstObject& obj, var& value)
     {
         using alt_t = std::variant_alternative_t<N, var>;
-        alt_t alt;
+        // The alternative is filled in place, reusing the one already held when the index matches
+        if (value.index() != N)
+            value.template emplace<N>();
+        auto& alt = std::get<N>(value);
         if constexpr (!struct_like<alt_t>)
         {
             auto dataMember = obj.FindMember("value");
-            if (dataMember == obj.MemberEnd() || !adapter<alt_t>::get(dataMember->value, alt))
+            if (dataMember == obj.MemberEnd() || !detail::get_traced(dataMember->value, alt, "value"))
                 return false;
         }
         else
@@ -240,7 +847,6 @@ struct adapter<std::variant<T...>>
             if (!adapter<alt_t>::get(obj, alt))
                 return false;
         }
-        value = std::move(alt);
         return true;
     }
 
@@ -338,7 +944,11 @@ struct adapter<Enum>
     }
     static void set(allocator& a, value_r v, Enum value)
     {
-        adapter<std::string>::set(a, v, enum_names<Enum>::get_names()[(size_t)value]);
+        const char* name = enum_names<Enum>::get_names()[(size_t)value];
+        if (detail::active_write_options().borrow_strings)
+            v.SetString(rapidjson::StringRef(name));
+        else
+            v.SetString(name, a);
     }
 };
 
@@ -425,6 +1035,7 @@ struct adapter<A>
     {
         if (!v.IsArray())
             return false;
+        detail::check_cancellation();
         auto arr = v.GetArray();
         if constexpr (resizable<A>)
         {
@@ -438,20 +1049,31 @@ struct adapter<A>
             if constexpr (fillable<A>)
                 value.fill({});
         }
-        for (size_t i = 0; i < (size_t)arr.Size(); ++i)
-            if (!adapter<typename A::value_type>::get(arr[(rapidjson::SizeType)i], value[i]))
+        for (size_t i = 0; auto& item : arr)
+        {
+            if (!detail::get_traced(item, value[i], i))
                 return false;
+            ++i;
+        }
         return true;
     }
     static void set(allocator& a, value_r v, const A& value)
     {
-        auto& items = v.SetArray();
-        items.Reserve((rapidjson::SizeType)value.size(), a);
-        for (size_t i = 0; i < value.size(); ++i)
+        detail::check_cancellation();
+        const auto size = detail::checked_size(value.size());
+        if (!detail::active_write_options().update || !v.IsArray())
+            v.SetArray();
+        // In update mode the existing elements are overwritten in place
+        while (v.Size() > size)
+            v.PopBack();
+        for (rapidjson::SizeType i = 0; i < v.Size(); ++i)
+            adapter<typename A::value_type>::set(a, v[i], value[i]);
+        v.Reserve(size, a);
+        for (size_t i = v.Size(); i < value.size(); ++i)
         {
             rapidjson::Value item;
             adapter<typename A::value_type>::set(a, item, value[i]);
-            items.PushBack(item, a);
+            v.PushBack(item, a);
         }
     }
 };
@@ -461,7 +1083,7 @@ concept map_like = sizable<T> && std::forward_iterator<typename T::const_iterato
     requires(T & m, const T & cm, std::pair<typename T::key_type, typename T::mapped_type>& p)
 {
     { m[typename T::key_type{}] } -> std::same_as<typename T::mapped_type&>;
-    { cm[typename T::key_type{}] } -> std::same_as<const typename T::mapped_type&>;
+    { cm.find(typename T::key_type{}) } -> std::same_as<typename T::const_iterator>;
     m.emplace(typename T::key_type{}, typename T::mapped_type{});
     { cm.begin() } -> std::same_as<typename T::const_iterator>;
     { cm.end() } -> std::same_as<typename T::const_iterator>;
@@ -476,36 +1098,154 @@ struct adapter<M>
     {
         if (!v.IsObject())
             return false;
+        detail::check_cancellation();
         auto m = v.GetObject();
         value.clear();
         if constexpr (reservable<M>)
             value.reserve(m.MemberCount());
         for (auto& vi : m)
         {
-            typename M::mapped_type item;
-            if (!adapter<typename M::mapped_type>::get(vi.value, item))
-                return false;
+            const detail::error_path::segment segment{ vi.name.GetString(), vi.name.GetStringLength() };
             typename M::key_type key;
-            if (!adapter<typename M::key_type>::get(vi.name, key))
+            if (!detail::get_traced(vi.name, key, segment))
                 return false;
-            value.emplace(std::move(key), std::move(item));
+            if constexpr (requires { value.try_emplace(std::move(key)); })
+            {
+                // The item is constructed in its node and filled there; a duplicate key keeps the first item
+                if (auto [it, inserted] = value.try_emplace(std::move(key)); inserted)
+                {
+                    if (!detail::get_traced(vi.value, it->second, segment))
+                        return false;
+                }
+                else
+                {
+                    typename M::mapped_type duplicate;
+                    if (!detail::get_traced(vi.value, duplicate, segment))
+                        return false;
+                }
+            }
+            else
+            {
+                typename M::mapped_type item;
+                if (!detail::get_traced(vi.value, item, segment))
+                    return false;
+                value.emplace(std::move(key), std::move(item));
+            }
         }
         return true;
     }
     static void set(allocator& a, value_r v, const M& value)
     {
+        detail::check_cancellation();
         auto& items = v.SetObject();
-        items.MemberReserve(value.size(), a);
-        for (auto& [k, val] : value)
+        items.MemberReserve(detail::checked_size(value.size()), a);
+        auto add = [&](const typename M::key_type& k, const typename M::mapped_type& val)
         {
             rapidjson::Value item, key;
             adapter<typename M::mapped_type>::set(a, item, val);
             adapter<typename M::key_type>::set(a, key, k);
             items.AddMember(key, item, a);
+        };
+        if constexpr (!requires { typename M::key_compare; })
+        {
+            if (detail::active_write_options().canonical)
+            {
+                // Without an order of the keys the output would depend on the hash table layout
+                if constexpr (!std::totally_ordered<typename M::key_type>)
+                    throw std::invalid_argument("Canonical output of an unordered map needs a totally ordered key type");
+                else
+                {
+                    // Items of unordered maps in key order through a sorted index, the map itself is not copied
+                    std::vector<typename M::const_iterator> order;
+                    order.reserve(value.size());
+                    for (auto it = value.begin(); it != value.end(); ++it)
+                        order.push_back(it);
+                    std::sort(order.begin(), order.end(), [](const auto& x, const auto& y) { return x->first < y->first; });
+                    for (const auto& it : order)
+                        add(it->first, it->second);
+                    return;
+                }
+            }
         }
+        for (auto& [k, val] : value)
+            add(k, val);
     }
 };
 
+template<class T>
+inline constexpr bool is_nullable = false;
+template<class T>
+inline constexpr bool is_nullable<std::optional<T>> = true;
+template<class T>
+inline constexpr bool is_nullable<std::unique_ptr<T>> = true;
+template<class T>
+inline constexpr bool is_nullable<std::shared_ptr<T>> = true;
+template<class T>
+inline constexpr bool is_nullable<T*> = true;
+
+namespace detail
+{
+struct omitted_values
+{
+    rapidjson::Value null_value;
+    rapidjson::Value empty_array{ rapidjson::kArrayType };
+    rapidjson::Value empty_object{ rapidjson::kObjectType };
+};
+inline const omitted_values& omitted()
+{
+    static const omitted_values values;
+    return values;
+}
+
+// Strings look like resizable arrays of char, but they are written as JSON strings and stay required
+template<class T>
+inline constexpr bool is_basic_string = false;
+template<class Ch, class Traits, class Alloc>
+inline constexpr bool is_basic_string<std::basic_string<Ch, Traits, Alloc>> = true;
+template<class T>
+inline constexpr bool is_optional = false;
+template<class T>
+inline constexpr bool is_optional<std::optional<T>> = true;
+template<class T>
+inline constexpr bool is_variant = false;
+template<class... T>
+inline constexpr bool is_variant<std::variant<T...>> = true;
+
+// What an absent member of type T is read as: null for nullable types, empty for containers, nothing otherwise.
+// write_options::omit_empty leaves out exactly the members holding this value.
+template<class T>
+const rapidjson::Value* omitted_value()
+{
+    if constexpr (is_nullable<T>)
+        return &omitted().null_value;
+    else if constexpr (array_like<T> && resizable<T> && !is_basic_string<T>)
+        return &omitted().empty_array;
+    else if constexpr (map_like<T>)
+        return &omitted().empty_object;
+    else
+        return nullptr;
+}
+
+// What an absent member of type T is read as by the load running on this thread: its omitted_value
+// under load_options::omit_empty, otherwise nothing, so the member is required
+template<class T>
+const rapidjson::Value* absent_value()
+{
+    return active_load_options().omit_empty ? omitted_value<T>() : nullptr;
+}
+
+inline bool is_omitted(value_c v, const rapidjson::Value* omitted)
+{
+    if (!omitted)
+        return false;
+    if (omitted->IsNull())
+        return v.IsNull();
+    if (omitted->IsArray())
+        return v.IsArray() && v.Empty();
+    return v.IsObject() && v.ObjectEmpty();
+}
+}
+
 template<class T>
 struct adapter<std::shared_ptr<T>>
 {
@@ -516,10 +1256,11 @@ struct adapter<std::shared_ptr<T>>
             value.reset();
             return true;
         }
-        T x;
-        if (!adapter<T>::get(v, x))
+        // A fresh object, the old one may still be used by other owners
+        auto x = std::make_shared<T>();
+        if (!adapter<T>::get(v, *x))
             return false;
-        value = std::make_shared<T>(std::move(x));
+        value = std::move(x);
         return true;
     }
     static void set(allocator& a, value_r v, const std::shared_ptr<T>& value)
@@ -541,11 +1282,21 @@ struct adapter<std::unique_ptr<T>>
             value.reset();
             return true;
         }
-        T x;
-        if (!adapter<T>::get(v, x))
-            return false;
-        value = std::make_unique<T>(std::move(x));
-        return true;
+        if (!value)
+            value = std::make_unique<T>();
+        // As for std::optional, an object left partly loaded by a failure is dropped
+        try
+        {
+            if (adapter<T>::get(v, *value))
+                return true;
+        }
+        catch (...)
+        {
+            value.reset();
+            throw;
+        }
+        value.reset();
+        return false;
     }
     static void set(allocator& a, value_r v, const std::unique_ptr<T>& value)
     {
@@ -589,11 +1340,21 @@ struct adapter<std::optional<T>>
             value = std::nullopt;
             return true;
         }
-        T x;
-        if (!adapter<T>::get(v, x))
-            return false;
-        value.reset(std::move(x));
-        return true;
+        if (!value)
+            value.emplace();
+        // Filled in place, so a failure would leave it partly loaded: it is reset then
+        try
+        {
+            if (adapter<T>::get(v, *value))
+                return true;
+        }
+        catch (...)
+        {
+            value.reset();
+            throw;
+        }
+        value.reset();
+        return false;
     }
     static void set(allocator& a, value_r v, const std::optional<T>& value)
     {
@@ -604,126 +1365,2033 @@ struct adapter<std::optional<T>>
     }
 };
 
-template<class T>
-concept with_backend = requires(const T & cx)
+// Load-only field type for very large strings: the value is passed to the callback in chunks instead of being stored,
+// optionally decoded from base64 on the fly. load_blobs keeps such values out of the DOM as well.
+class blob_sink
 {
-    cx.get_backend();
-};
+public:
+    using callback = std::function<void(std::span<const char>)>;
+    static constexpr size_t chunk_size = 64 * 1024;
 
-template<with_backend WB>
-struct adapter<WB>
+    blob_sink() = default;
+    explicit blob_sink(callback cb, bool base64 = false) : _callback(std::move(cb)), _base64(base64) {}
+
+    // Takes the next part of the unescaped string value
+    void write(const char* data, size_t size)
+    {
+        if (!_base64)
+        {
+            for (size_t done = 0; done < size; done += chunk_size)
+                deliver(data + done, std::min(chunk_size, size - done));
+            return;
+        }
+        for (size_t i = 0; i < size; ++i)
+            decode(data[i]);
+    }
+    // Ends the value, flushing the decoded bytes which are still buffered
+    void finish()
+    {
+        if (_base64)
+        {
+            if (_count == 1 || (_padding != 0 && _count + _padding != 4))
+                throw parse_exception("Invalid base64 length in blob");
+            if (_count >= 2)
+                put((char)(_quad >> (_count == 2 ? 4 : 10)));
+            if (_count == 3)
+                put((char)(_quad >> 2));
+            _quad = 0;
+            _count = 0;
+            _padding = 0;
+            if (!_buffer.empty())
+                deliver(_buffer.data(), _buffer.size());
+            _buffer.clear();
+        }
+        _received = true;
+    }
+    // Bytes passed to the callback so far
+    size_t size() const { return _size; }
+    // Whether a whole value has been passed to the callback
+    bool received() const { return _received; }
+private:
+    callback _callback;
+    bool _base64 = false;
+    bool _received = false;
+    size_t _size = 0;
+    uint32_t _quad = 0;
+    unsigned _count = 0;
+    unsigned _padding = 0;
+    std::string _buffer;
+
+    void deliver(const char* data, size_t size)
+    {
+        _size += size;
+        if (_callback)
+            _callback(std::span<const char>(data, size));
+    }
+    void put(char c)
+    {
+        if (_buffer.capacity() < chunk_size)
+            _buffer.reserve(chunk_size);
+        _buffer.push_back(c);
+        if (_buffer.size() == chunk_size)
+        {
+            deliver(_buffer.data(), _buffer.size());
+            _buffer.clear();
+        }
+    }
+    void decode(char c)
+    {
+        int d;
+        if (c >= 'A' && c <= 'Z')
+            d = c - 'A';
+        else if (c >= 'a' && c <= 'z')
+            d = c - 'a' + 26;
+        else if (c >= '0' && c <= '9')
+            d = c - '0' + 52;
+        else if (c == '+' || c == '-')
+            d = 62;
+        else if (c == '/' || c == '_')
+            d = 63;
+        else if (c == ' ' || c == '\r' || c == '\n' || c == '\t')
+            return;
+        else if (c == '=' && _count >= 2)
+        {
+            ++_padding;
+            return;
+        }
+        else
+            throw parse_exception("Invalid base64 character in blob");
+        if (_padding != 0)
+            throw parse_exception("Invalid base64 padding in blob");
+        _quad = (_quad << 6) | (uint32_t)d;
+        if (++_count == 4)
+        {
+            put((char)(_quad >> 16));
+            put((char)(_quad >> 8));
+            put((char)_quad);
+            _quad = 0;
+            _count = 0;
+        }
+    }
+};
+
+// No set: a blob_sink cannot be dumped
+template<>
+struct adapter<blob_sink>
+{
+    static bool get(value_c v, blob_sink& value)
+    {
+        // load_blobs has already delivered the value and left null in its place
+        if (v.IsNull())
+            return true;
+        if (!v.IsString())
+            return false;
+        value.write(v.GetString(), v.GetStringLength());
+        value.finish();
+        return true;
+    }
+};
+
+template<class T>
+concept with_backend = requires(const T & cx)
+{
+    cx.get_backend();
+};
+
+template<with_backend WB>
+struct adapter<WB>
+{
+    using backend_type = std::decay_t<decltype(std::declval<WB>().get_backend())>;
+    static bool get(value_c v, WB& value)
+    {
+        return adapter<backend_type>::get(v, value.get_backend());
+    }
+    static void set(allocator& a, value_r v, const WB& value)
+    {
+        // A backend returned by value dies before the document, so its strings must be copied
+        if constexpr (!std::is_reference_v<decltype(value.get_backend())>)
+        {
+            if (detail::active_write_options().borrow_strings)
+            {
+                write_options options = detail::active_write_options();
+                options.borrow_strings = false;
+                detail::write_options_scope scope(options);
+                adapter<backend_type>::set(a, v, value.get_backend());
+                return;
+            }
+        }
+        adapter<backend_type>::set(a, v, value.get_backend());
+    }
+};
+
+template<class T>
+const json_reader& json_reader::operator()(const char* name, T& value) const
+{
+    auto member = _v.FindMember(name);
+    const rapidjson::Value* v = member != _v.MemberEnd() ? &member->value : detail::absent_value<T>();
+    if (!v)
+        detail::throw_field_not_found(name, _type_name);
+    if (!detail::get_traced(*v, value, name))
+        detail::throw_cannot_parse(name, _type_name);
+    return *this;
+}
+template<class T>
+const json_reader& json_reader::operator()(const char* name, std::decay_t<T>* p_value) const
+{
+    if (p_value == nullptr)
+        return *this;
+    auto member = _v.FindMember(name);
+    const rapidjson::Value* v = member != _v.MemberEnd() ? &member->value : detail::absent_value<std::decay_t<T>>();
+    if (!v)
+        detail::throw_field_not_found(name, _type_name);
+    if (!detail::get_traced(*v, *p_value, name))
+        detail::throw_cannot_parse(name, _type_name);
+    return *this;
+}
+template<class T, std::convertible_to<T> TT>
+    requires(!std::assignable_from<T, TT>)
+const json_reader& json_reader::operator()(const char* name, T& value, const TT& default_value) const
+{
+    if (auto member = _v.FindMember(name); member == _v.MemberEnd())
+        value = static_cast<T>(default_value);
+    else if (!detail::get_traced(member->value, value, name))
+        detail::throw_cannot_parse(name, _type_name);
+    return *this;
+}
+template<class TT, std::assignable_from<TT> T>
+const json_reader& json_reader::operator()(const char* name, T& value, const TT& default_value) const
+{
+    if (auto member = _v.FindMember(name); member == _v.MemberEnd())
+        value = default_value;
+    else if (!detail::get_traced(member->value, value, name))
+        detail::throw_cannot_parse(name, _type_name);
+    return *this;
+}
+template<class T, class TT>
+    requires std::is_convertible_v<std::invoke_result_t<TT>, T>
+const json_reader& json_reader::operator()(const char* name, std::decay_t<T>& value, TT default_value_maker) const
+{
+    if (auto member = _v.FindMember(name); member == _v.MemberEnd())
+        value = static_cast<T>(default_value_maker());
+    else if (!detail::get_traced(member->value, value, name))
+        detail::throw_cannot_parse(name, _type_name);
+    return *this;
+}
+
+struct validation_error
+{
+    enum class reason { syntax, field_not_found, invalid_field, invalid_value };
+    reason what = reason::invalid_value;
+    const char* field = nullptr;
+    const char* type_name = nullptr;
+    rapidjson::ParseErrorCode code = rapidjson::kParseErrorNone;
+    size_t offset = 0;
+
+    std::string message() const
+    {
+        const std::string type = type_name ? type_name : "";
+        switch (what)
+        {
+        case reason::syntax:
+            return parse_exception(rapidjson::ParseResult(code, offset)).what();
+        case reason::field_not_found:
+            return std::string("Field not found: ") + field + " in type " + type;
+        case reason::invalid_field:
+            return std::string("Cannot parse field: ") + field + " in type " + type;
+        default:
+            return "Cannot convert the value";
+        }
+    }
+};
+
+template<class T>
+struct validator;
+
+// Checks members with the same rules as json_reader, but never writes to the fields
+class json_validator
+{
+    const rapidjson::Value& _v;
+    std::optional<validation_error>& _error;
+    const char* _type_name = nullptr;
+
+    template<class T>
+    void check_member(const char* name, bool required) const
+    {
+        if (_error)
+            return;
+        auto member = _v.FindMember(name);
+        if (member == _v.MemberEnd())
+        {
+            if (required)
+                _error = validation_error{ validation_error::reason::field_not_found, name, _type_name };
+            return;
+        }
+        if (!validator<std::remove_cv_t<T>>::check(member->value, _error) && !_error)
+            _error = validation_error{ validation_error::reason::invalid_field, name, _type_name };
+    }
+public:
+    json_validator(const rapidjson::Value& value, std::optional<validation_error>& error) : _v{ value }, _error{ error } {}
+    json_validator& operator()(const char* name) { _type_name = name; return *this; }
+    template<class T>
+    const json_validator& operator()(const char* name, T&) const
+    {
+        check_member<T>(name, !detail::absent_value<std::remove_cv_t<T>>());
+        return *this;
+    }
+    template<class T>
+    const json_validator& operator()(const char* name, std::decay_t<T>* p_value) const
+    {
+        if (p_value != nullptr)
+            check_member<T>(name, !detail::absent_value<std::decay_t<T>>());
+        return *this;
+    }
+    template<class T, class TT>
+    const json_validator& operator()(const char* name, T&, const TT&) const
+    {
+        check_member<T>(name, false);
+        return *this;
+    }
+};
+
+// validator<T>::check(v, error) accepts exactly the values adapter<T>::get accepts, without building the value
+// where that would allocate. error receives the innermost field failure.
+template<class T>
+struct validator
+{
+    static bool check(value_c v, std::optional<validation_error>& error)
+    {
+        T value;
+        if constexpr (struct_like<T>)
+        {
+            if (!v.IsObject())
+                return false;
+            json_validator io{ v, error };
+            value.serialization(io);
+            return !error;
+        }
+        else
+            return adapter<T>::get(v, value);
+    }
+};
+
+template<class Alloc>
+struct validator<std::basic_string<char, std::char_traits<char>, Alloc>>
+{
+    static bool check(value_c v, std::optional<validation_error>&) { return v.IsString(); }
+};
+
+template<class Enum>
+    requires std::is_enum_v<Enum> && std::is_same_v<const char*, typename decltype(enum_names<Enum>::get_names())::value_type>
+struct validator<Enum>
+{
+    static bool check(value_c v, std::optional<validation_error>&)
+    {
+        if (!v.IsString())
+            return false;
+        const std::string_view name{ v.GetString(), v.GetStringLength() };
+        for (const char* n : enum_names<Enum>::get_names())
+            if (name == n)
+                return true;
+        return false;
+    }
+};
+
+namespace detail
+{
+// Capacity of a fixed-size array type, known without constructing one
+template<class A>
+struct fixed_capacity;
+template<class A>
+    requires requires { std::tuple_size<A>::value; }
+struct fixed_capacity<A> : std::integral_constant<size_t, std::tuple_size_v<A>> {};
+template<class T, size_t N>
+struct fixed_capacity<array_with_size<T, N>> : std::integral_constant<size_t, N> {};
+}
+
+// Arrays of other fixed-size types are checked by the primary template
+template<array_like A>
+    requires resizable<A> || requires { detail::fixed_capacity<A>::value; }
+struct validator<A>
+{
+    static bool check(value_c v, std::optional<validation_error>& error)
+    {
+        if (!v.IsArray())
+            return false;
+        auto arr = v.GetArray();
+        if constexpr (!resizable<A>)
+            if (detail::fixed_capacity<A>::value < (size_t)arr.Size())
+                return false;
+        for (auto& item : arr)
+            if (!validator<typename A::value_type>::check(item, error))
+                return false;
+        return true;
+    }
+};
+
+template<map_like M>
+struct validator<M>
+{
+    static bool check(value_c v, std::optional<validation_error>& error)
+    {
+        if (!v.IsObject())
+            return false;
+        for (auto& vi : v.GetObject())
+            if (!validator<typename M::mapped_type>::check(vi.value, error) || !validator<typename M::key_type>::check(vi.name, error))
+                return false;
+        return true;
+    }
+};
+
+template<class T>
+struct nullable_validator
+{
+    static bool check(value_c v, std::optional<validation_error>& error)
+    {
+        return v.IsNull() || validator<std::remove_cv_t<T>>::check(v, error);
+    }
+};
+template<class T>
+struct validator<std::optional<T>> : nullable_validator<T> {};
+template<class T>
+struct validator<std::unique_ptr<T>> : nullable_validator<T> {};
+template<class T>
+struct validator<std::shared_ptr<T>> : nullable_validator<T> {};
+template<class T>
+struct validator<T*> : nullable_validator<T> {};
+
+template<class... T>
+struct validator<std::variant<T...>>
+{
+    using var = std::variant<T...>;
+    using indexer = typename variant_indexer<var>::type;
+
+    template<size_t N>
+    static bool check_one(value_c v, std::optional<validation_error>& error)
+    {
+        using alt_t = std::variant_alternative_t<N, var>;
+        if constexpr (!struct_like<alt_t>)
+        {
+            auto dataMember = v.FindMember("value");
+            return dataMember != v.MemberEnd() && validator<alt_t>::check(dataMember->value, error);
+        }
+        else
+            return validator<alt_t>::check(v, error);
+    }
+    template<size_t... N>
+    static bool check(value_c v, std::optional<validation_error>& error, size_t index, std::integer_sequence<size_t, N...>)
+    {
+        return ((index == N && check_one<N>(v, error)) || ...);
+    }
+    static bool check(value_c v, std::optional<validation_error>& error)
+    {
+        if (!v.IsObject())
+            return false;
+        auto typeMember = v.FindMember("type");
+        if (typeMember == v.MemberEnd())
+            return false;
+        indexer type;
+        if (!adapter<indexer>::get(typeMember->value, type))
+            return false;
+        return check(v, error, (size_t)type, std::make_integer_sequence<size_t, sizeof...(T)>{});
+    }
+};
+
+// Checks that json would be loaded by loads<T> without building T, returns the first violation.
+// The text is still parsed into a DOM, which holds its own copy of every string; only the DTO
+// and its strings and containers are not built.
+template<class T>
+std::optional<validation_error> validate(std::string_view json)
+{
+    std::optional<validation_error> error;
+    rapidjson::Document doc;
+    if (rapidjson::ParseResult pr = doc.Parse(json.data(), json.size()); pr.IsError())
+        return validation_error{ validation_error::reason::syntax, nullptr, nullptr, pr.Code(), pr.Offset() };
+    if (!validator<T>::check(doc, error) && !error)
+        error = validation_error{};
+    return error;
+}
+template<class T>
+std::optional<validation_error> validate(std::string_view json, const load_options& options)
+{
+    detail::load_options_scope scope(options);
+    return validate<T>(json);
+}
+
+namespace detail
+{
+// Converts the root value; the error path is rendered only if the conversion fails.
+// source() returns the text the value was parsed from and is called only in that case.
+template<class T, class Source>
+    requires std::is_invocable_v<Source&>
+void convert_root(value_c v, T& result, Source&& source)
+{
+    current_error_path.size = 0;
+    try
+    {
+        if (!adapter<T>::get(v, result))
+            throw parse_exception("Cannot convert the value");
+    }
+    catch (parse_exception& e)
+    {
+        const auto& text = source();
+        if (const auto location = error_location(text); !location.empty())
+            e.add_location(location);
+        throw;
+    }
+}
+template<class T>
+void convert_root(value_c v, T& result, std::string_view text)
+{
+    convert_root(v, result, [text] { return text; });
+}
+}
+
+// Serializes value into v, which may be a part of a bigger document; new strings, members and elements are
+// allocated from a, the allocator of that document. With options.update the members v already has are overwritten
+// in place.
+template<class T>
+void to_value(const T& value, rapidjson::Value& v, allocator& a, const write_options& options = {})
+{
+    detail::write_options_scope scope(options);
+    adapter<T>::set(a, v, value);
+}
+
+template<class T>
+void from_value(value_c v, T& result)
+{
+    detail::convert_root(v, result, {});
+}
+template<class T>
+T from_value(value_c v)
+{
+    T result;
+    from_value(v, result);
+    return result;
+}
+template<class T>
+void from_value(value_c v, T& result, const load_options& options)
+{
+    detail::load_options_scope scope(options);
+    from_value(v, result);
+}
+
+namespace detail
+{
+// Field of a DTO in the type-erased table mode; the functions are shared by all DTOs with fields of the same type
+struct field_entry
+{
+    const char* name = nullptr;
+    size_t offset = 0;
+    bool (*get)(value_c, void*) = nullptr;
+    void (*set)(allocator&, value_r, const void*) = nullptr;
+    const rapidjson::Value* omitted = nullptr;
+    // Set for fields with a default value or default value maker
+    std::shared_ptr<const void> default_value;
+    void (*assign_default)(const void*, void*) = nullptr;
+    bool (*is_default)(const void*, const void*) = nullptr;
+};
+
+struct field_table
+{
+    const char* type_name = nullptr;
+    std::vector<field_entry> fields;
+};
+
+template<class T>
+bool erased_get(value_c v, void* value) { return adapter<T>::get(v, *static_cast<T*>(value)); }
+template<class T>
+void erased_set(allocator& a, value_r v, const void* value) { adapter<T>::set(a, v, *static_cast<const T*>(value)); }
+
+// IO object which records name, offset and conversion functions of every field of a sample object
+template<class DTO>
+class field_table_builder
+{
+    field_table& _table;
+    const DTO& _sample;
+
+    template<class T>
+    field_entry& add(const char* name, const T& value)
+    {
+        const auto offset = (size_t)(reinterpret_cast<const char*>(&value) - reinterpret_cast<const char*>(&_sample));
+        if (offset > sizeof(DTO) - sizeof(T))
+            throw std::logic_error(std::string("Field ") + name + " is not a data member, it cannot be used in a field table");
+        auto& entry = _table.fields.emplace_back();
+        entry.name = name;
+        entry.offset = offset;
+        entry.get = &erased_get<T>;
+        entry.set = &erased_set<T>;
+        entry.omitted = omitted_value<T>();
+        return entry;
+    }
+public:
+    field_table_builder(field_table& table, const DTO& sample) : _table(table), _sample(sample) {}
+    field_table_builder& operator()(const char* name) { _table.type_name = name; return *this; }
+    template<class T>
+    field_table_builder& operator()(const char* name, T& value)
+    {
+        add(name, value);
+        return *this;
+    }
+    template<class T, class TT>
+        requires std::convertible_to<const TT&, T> || has_equal_with<T, TT>
+    field_table_builder& operator()(const char* name, T& value, const TT& default_value)
+    {
+        auto& entry = add(name, value);
+        entry.default_value = std::make_shared<const TT>(default_value);
+        entry.assign_default = [](const void* d, void* v)
+        {
+            *static_cast<T*>(v) = static_cast<T>(*static_cast<const TT*>(d));
+        };
+        entry.is_default = [](const void* d, const void* v) -> bool
+        {
+            if constexpr (has_equal_with<T, TT>)
+                return *static_cast<const T*>(v) == *static_cast<const TT*>(d);
+            else
+                return *static_cast<const T*>(v) == static_cast<T>(*static_cast<const TT*>(d));
+        };
+        return *this;
+    }
+    template<class T, class TT>
+        requires std::is_convertible_v<std::invoke_result_t<TT>, T>
+    field_table_builder& operator()(const char* name, T& value, TT default_value_maker)
+    {
+        using made = std::invoke_result_t<TT>;
+        auto& entry = add(name, value);
+        entry.default_value = std::make_shared<const TT>(std::move(default_value_maker));
+        entry.assign_default = [](const void* d, void* v)
+        {
+            *static_cast<T*>(v) = static_cast<T>((*static_cast<const TT*>(d))());
+        };
+        entry.is_default = [](const void* d, const void* v) -> bool
+        {
+            if constexpr (has_equal_with<T, made>)
+                return *static_cast<const T*>(v) == (*static_cast<const TT*>(d))();
+            else
+                return *static_cast<const T*>(v) == static_cast<T>((*static_cast<const TT*>(d))());
+        };
+        return *this;
+    }
+};
+
+template<class DTO>
+field_table build_field_table()
+{
+    field_table table;
+    DTO sample{};
+    field_table_builder<DTO> builder{ table, sample };
+    sample.serialization(builder);
+    return table;
+}
+
+// The engine shared by all DTOs in the table mode, equivalent to json_reader and json_writer
+inline bool read_fields(const field_table& table, value_c v, void* object)
+{
+    if (!v.IsObject())
+        return false;
+    check_cancellation();
+    auto* base = static_cast<char*>(object);
+    for (const auto& f : table.fields)
+    {
+        void* field = base + f.offset;
+        auto member = v.FindMember(f.name);
+        const rapidjson::Value* source = member != v.MemberEnd() ? &member->value : nullptr;
+        if (!source && f.assign_default)
+        {
+            f.assign_default(f.default_value.get(), field);
+            continue;
+        }
+        if (!source && !(source = active_load_options().omit_empty ? f.omitted : nullptr))
+            throw_field_not_found(f.name, table.type_name);
+        bool converted;
+        try
+        {
+            converted = f.get(*source, field);
+        }
+        catch (const parse_exception&)
+        {
+            current_error_path.push(f.name);
+            throw;
+        }
+        if (!converted)
+        {
+            current_error_path.push(f.name);
+            throw_cannot_parse(f.name, table.type_name);
+        }
+    }
+    return true;
+}
+
+inline void write_fields(const field_table& table, allocator& a, value_r v, const void* object)
+{
+    check_cancellation();
+    if (!v.IsObject())
+        v.SetObject();
+    const write_options& options = active_write_options();
+    const auto* base = static_cast<const char*>(object);
+    for (const auto& f : table.fields)
+    {
+        const void* field = base + f.offset;
+        if (f.is_default && f.is_default(f.default_value.get(), field))
+        {
+            if (options.update)
+                v.EraseMember(f.name);
+            continue;
+        }
+        if (options.update)
+        {
+            if (auto member = v.FindMember(f.name); member != v.MemberEnd())
+            {
+                f.set(a, member->value, field);
+                if (options.omit_empty && is_omitted(member->value, f.omitted))
+                    v.EraseMember(member);
+                continue;
+            }
+        }
+        rapidjson::Value key, item;
+        f.set(a, item, field);
+        if (options.omit_empty && is_omitted(item, f.omitted))
+            continue;
+        if (options.borrow_strings)
+            key.SetString(rapidjson::StringRef(f.name));
+        else
+            key.SetString(f.name, a);
+        v.AddMember(key, item, a);
+    }
+}
+}
+
+namespace detail
+{
+template<class T>
+inline constexpr char type_tag = 0;
+
+// Field of the source object of convert. Data members are referenced, other values are written to dom right away.
+struct source_field
+{
+    const char* name = nullptr;
+    const void* value = nullptr;
+    const void* type = nullptr;
+    void (*set)(allocator&, value_r, const void*) = nullptr;
+    rapidjson::Value dom;
+};
+
+// IO object which lists the fields the source object would write, with the overloads of json_writer
+template<class From>
+class source_collector
+{
+    std::vector<source_field>& _fields;
+    const From& _from;
+    allocator& _a;
+
+    template<class T>
+    void add(const char* name, const T& value)
+    {
+        auto& f = _fields.emplace_back();
+        f.name = name;
+        f.type = &type_tag<T>;
+        f.set = &erased_set<T>;
+        const auto* p = reinterpret_cast<const char*>(&value);
+        const auto* object = reinterpret_cast<const char*>(&_from);
+        if (p >= object && p + sizeof(T) <= object + sizeof(From))
+            f.value = &value;
+        else
+            adapter<T>::set(_a, f.dom, value);
+    }
+public:
+    source_collector(std::vector<source_field>& fields, const From& from, allocator& a) : _fields(fields), _from(from), _a(a) {}
+    source_collector& operator()([[maybe_unused]] const char* name) { return *this; }
+    template<class T>
+    source_collector& operator()(const char* name, const T& value)
+    {
+        add(name, value);
+        return *this;
+    }
+    template<class T>
+    source_collector& operator()(const char* name, const std::decay_t<T>* p_value)
+    {
+        if (p_value != nullptr)
+            add(name, *p_value);
+        return *this;
+    }
+    template<class T, std::convertible_to<T> TT>
+        requires(!has_equal_with<T, TT>)
+    source_collector& operator()(const char* name, const T& value, TT default_value)
+    {
+        if (!(value == (T)default_value))
+            add<std::remove_cv_t<T>>(name, value);
+        return *this;
+    }
+    template<class T, has_equal_with<T> TT>
+    source_collector& operator()(const char* name, const T& value, TT default_value)
+    {
+        if (!(value == default_value))
+            add<std::remove_cv_t<T>>(name, value);
+        return *this;
+    }
+    template<class T, class TT>
+        requires std::is_convertible_v<std::invoke_result_t<TT>, T>
+    source_collector& operator()(const char* name, const T& value, TT default_value_maker)
+    {
+        return operator()(name, value, default_value_maker());
+    }
+};
+
+template<class T>
+bool copies_deep();
+
+// IO object which checks whether all fields of an object copy deep
+struct deep_copy_probe
+{
+    bool deep = true;
+    deep_copy_probe& operator()([[maybe_unused]] const char* name) { return *this; }
+    template<class T, class... Default>
+    deep_copy_probe& operator()([[maybe_unused]] const char* name, T&&, const Default&...)
+    {
+        deep = deep && copies_deep<std::remove_cvref_t<T>>();
+        return *this;
+    }
+};
+
+// A DTO is checked once by a sample of it. One which contains itself, directly or not, is taken as not copying deep.
+template<class T>
+bool struct_copies_deep()
+{
+    // 0 while unknown, then 1 if T copies deep and 2 if not
+    static std::atomic<int> known{ 0 };
+    static thread_local bool visiting = false;
+    if (const int k = known.load(std::memory_order_relaxed))
+        return k == 1;
+    if (visiting)
+        return false;
+    bool deep = false;
+    if constexpr (std::is_default_constructible_v<T> && requires(T& t, deep_copy_probe& io) { t.serialization(io); })
+    {
+        struct visit
+        {
+            bool& flag;
+            ~visit() { flag = false; }
+        } guard{ visiting = true };
+        T sample{};
+        deep_copy_probe probe;
+        sample.serialization(probe);
+        deep = probe.deep;
+    }
+    known.store(deep ? 1 : 2, std::memory_order_relaxed);
+    return deep;
+}
+
+// Whether copy assignment of T makes a value independent of the source, as loading it from JSON would.
+// Pointers and shared ownership are shared by a copy, also inside containers; types with other adapters may be too.
+template<class T>
+bool copies_deep()
+{
+    if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T> || is_basic_string<T> || bitset_like<T>)
+        return true;
+    else if constexpr (is_optional<T>)
+        return copies_deep<typename T::value_type>();
+    else if constexpr (is_variant<T>)
+        return []<size_t... I>(std::index_sequence<I...>)
+        {
+            return (copies_deep<std::variant_alternative_t<I, T>>() && ...);
+        }(std::make_index_sequence<std::variant_size_v<T>>{});
+    else if constexpr (map_like<T>)
+        return copies_deep<typename T::key_type>() && copies_deep<typename T::mapped_type>();
+    else if constexpr (array_like<T>)
+        return copies_deep<typename T::value_type>();
+    else if constexpr (struct_like<T>)
+        return struct_copies_deep<T>();
+    else
+        return false;
+}
+
+// IO object which fills the target object from the collected source fields, with the overloads of json_reader
+class target_filler
+{
+    std::vector<source_field>& _fields;
+    allocator& _a;
+    const char* _type_name = nullptr;
+    mutable size_t _next = 0;
+
+    // Fields mostly come in the same order in both types, so the next one is tried first
+    source_field* find(const char* name) const
+    {
+        if (_next < _fields.size() && std::strcmp(_fields[_next].name, name) == 0)
+            return &_fields[_next++];
+        for (size_t i = 0; i < _fields.size(); ++i)
+            if (std::strcmp(_fields[i].name, name) == 0)
+            {
+                _next = i + 1;
+                return &_fields[i];
+            }
+        return nullptr;
+    }
+    template<class T>
+    void fill(source_field& f, T& value) const
+    {
+        if constexpr (std::is_copy_assignable_v<T>)
+        {
+            if (f.value && f.type == &type_tag<T> && copies_deep<T>())
+            {
+                value = *static_cast<const T*>(f.value);
+                return;
+            }
+        }
+        if (f.value)
+        {
+            f.set(_a, f.dom, f.value);
+            f.value = nullptr;
+        }
+        if (!get_traced(f.dom, value, f.name))
+            throw_cannot_parse(f.name, _type_name);
+    }
+public:
+    target_filler(std::vector<source_field>& fields, allocator& a) : _fields(fields), _a(a) {}
+    target_filler& operator()(const char* name) { _type_name = name; return *this; }
+    template<class T>
+    const target_filler& operator()(const char* name, T& value) const
+    {
+        if (auto* f = find(name))
+            fill(*f, value);
+        else if (const auto* omitted = absent_value<T>())
+        {
+            if (!get_traced(*omitted, value, name))
+                throw_cannot_parse(name, _type_name);
+        }
+        else
+            throw_field_not_found(name, _type_name);
+        return *this;
+    }
+    template<class T>
+    const target_filler& operator()(const char* name, std::decay_t<T>* p_value) const
+    {
+        if (p_value != nullptr)
+            operator()(name, *p_value);
+        return *this;
+    }
+    template<class T, class TT>
+        requires std::convertible_to<const TT&, T> || std::assignable_from<T&, const TT&>
+    const target_filler& operator()(const char* name, T& value, const TT& default_value) const
+    {
+        if (auto* f = find(name))
+            fill(*f, value);
+        else if constexpr (std::convertible_to<const TT&, T>)
+            value = static_cast<T>(default_value);
+        else
+            value = default_value;
+        return *this;
+    }
+    template<class T, class TT>
+        requires std::is_convertible_v<std::invoke_result_t<TT>, T>
+    const target_filler& operator()(const char* name, T& value, TT default_value_maker) const
+    {
+        if (auto* f = find(name))
+            fill(*f, value);
+        else
+            value = static_cast<T>(default_value_maker());
+        return *this;
+    }
+};
+}
+
+// Converts between types with the same JSON representation, e.g. versions of a DTO, without formatting text.
+// Fields are matched by name; fields of the same type are copied unless a copy would share pointed-to objects,
+// the others go through their adapters, and fields missing from the source get the defaults of To.
+template<class To, class From>
+void convert(const From& from, To& to)
+{
+    allocator a;
+    detail::current_error_path.size = 0;
+    try
+    {
+        if constexpr (struct_like<From> && struct_like<To>)
+        {
+            std::vector<detail::source_field> fields;
+            detail::source_collector<From> collector{ fields, from, a };
+            const_cast<From&>(from).serialization(collector);
+            detail::target_filler filler{ fields, a };
+            to.serialization(filler);
+        }
+        else
+        {
+            if constexpr (std::is_same_v<From, To> && std::is_copy_assignable_v<To>)
+            {
+                if (detail::copies_deep<To>())
+                {
+                    to = from;
+                    return;
+                }
+            }
+            rapidjson::Value v;
+            adapter<From>::set(a, v, from);
+            if (!adapter<To>::get(v, to))
+                throw parse_exception("Cannot convert the value");
+        }
+    }
+    catch (parse_exception& e)
+    {
+        if (const auto location = detail::error_location({}); !location.empty())
+            e.add_location(location);
+        throw;
+    }
+}
+template<class To, class From>
+To convert(const From& from)
+{
+    To result;
+    convert(from, result);
+    return result;
+}
+// With options.omit_empty, fields of To missing from From are set null or empty as in load_options
+template<class To, class From>
+void convert(const From& from, To& to, const load_options& options)
+{
+    detail::load_options_scope scope(options);
+    convert(from, to);
+}
+
+namespace detail
+{
+inline std::atomic<bool> adaptive_capacity{ true };
+inline std::atomic<unsigned> capacity_generation{ 0 };
+// Upper bound of a learned capacity, so a few huge documents do not make every later call reserve that much
+inline std::atomic<size_t> max_capacity_hint{ 64u << 20 };
+
+// Exponentially weighted moving average of the sizes seen for one type; races between threads only blur it
+class size_estimate
+{
+    std::atomic<size_t> _value{ 0 };
+    std::atomic<unsigned> _generation{ 0 };
+public:
+    size_t get() const
+    {
+        if (!adaptive_capacity.load(std::memory_order_relaxed) ||
+            _generation.load(std::memory_order_relaxed) != capacity_generation.load(std::memory_order_relaxed))
+            return 0;
+        const size_t value = _value.load(std::memory_order_relaxed);
+        return std::min(value + value / 8, max_capacity_hint.load(std::memory_order_relaxed));
+    }
+    void update(size_t sample)
+    {
+        if (!adaptive_capacity.load(std::memory_order_relaxed))
+            return;
+        const unsigned generation = capacity_generation.load(std::memory_order_relaxed);
+        size_t value = sample;
+        if (_generation.load(std::memory_order_relaxed) == generation)
+        {
+            const size_t old = _value.load(std::memory_order_relaxed);
+            value = old - old / 8 + sample / 8;
+        }
+        _value.store(value, std::memory_order_relaxed);
+        _generation.store(generation, std::memory_order_relaxed);
+    }
+};
+
+// Sizes of the DOM pool and of the serialized text of previous loads and dumps of T
+template<class T>
+struct capacity_hints
+{
+    static inline size_estimate dom;
+    static inline size_estimate text;
+
+    static size_t chunk_size() { return std::max<size_t>(64 * 1024, dom.get()); }
+};
+}
+
+// Turns preallocation from the sizes of previous loads and dumps on or off, e.g. for deterministic benchmarks
+inline void set_adaptive_capacity(bool enabled) { detail::adaptive_capacity = enabled; }
+// Forgets the sizes seen so far for all types
+inline void reset_capacity_hints() { ++detail::capacity_generation; }
+// Limits the DOM pool chunk and output buffer reserved from previous sizes, 64 MiB by default
+inline void set_max_capacity_hint(size_t bytes) { detail::max_capacity_hint = bytes; }
+
+template<class T>
+T loads(std::string_view str)
+{
+    allocator pool(detail::capacity_hints<T>::chunk_size());
+    rapidjson::Document doc(&pool);
+    if (rapidjson::ParseResult pr = doc.Parse(str.data(), str.size()); pr.IsError())
+        throw parse_exception(pr);
+    detail::capacity_hints<T>::dom.update(pool.Size());
+    T result;
+    detail::convert_root(doc, result, str);
+    return result;
+}
+// A std::string is null-terminated, so it is read through StringStream: no bounds checks,
+// and the vector paths of JSON_DTO_RAPIDJSON_SIMD
+template<class T, class String>
+    requires std::same_as<String, std::string>
+T loads(const String& str)
+{
+    allocator pool(detail::capacity_hints<T>::chunk_size());
+    rapidjson::Document doc(&pool);
+    rapidjson::StringStream is(str.c_str());
+    if (rapidjson::ParseResult pr = doc.ParseStream(is); pr.IsError())
+        throw parse_exception(pr);
+    // The stream ends at the first null character, so text after an embedded one would go unnoticed
+    if (is.Tell() != str.size())
+        throw parse_exception(rapidjson::ParseResult(rapidjson::kParseErrorDocumentRootNotSingular, is.Tell()));
+    detail::capacity_hints<T>::dom.update(pool.Size());
+    T result;
+    detail::convert_root(doc, result, str);
+    return result;
+}
+
+// rapidjson input stream over a chain of non-contiguous buffers
+class segmented_stream
+{
+    using segment = std::span<const char>;
+    const segment* _seg;
+    const segment* _end;
+    const char* _cur = nullptr;
+    const char* _seg_end = nullptr;
+    size_t _base = 0;
+
+    void skip_exhausted()
+    {
+        while (_cur == _seg_end && _seg != _end)
+        {
+            _base += _seg->size();
+            if (++_seg == _end)
+                return;
+            _cur = _seg->data();
+            _seg_end = _cur + _seg->size();
+        }
+    }
+public:
+    using Ch = char;
+    explicit segmented_stream(std::span<const segment> segments) :
+        _seg(segments.data()),
+        _end(segments.data() + segments.size())
+    {
+        if (_seg != _end)
+        {
+            _cur = _seg->data();
+            _seg_end = _cur + _seg->size();
+            skip_exhausted();
+        }
+    }
+    Ch Peek() const { return _cur == _seg_end ? '\0' : *_cur; }
+    Ch Take()
+    {
+        if (_cur == _seg_end)
+            return '\0';
+        const Ch c = *_cur++;
+        skip_exhausted();
+        return c;
+    }
+    size_t Tell() const { return _seg == _end ? _base : _base + (size_t)(_cur - _seg->data()); }
+
+    Ch* PutBegin() { assert(false); return nullptr; }
+    void Put(Ch) { assert(false); }
+    void Flush() { assert(false); }
+    size_t PutEnd(Ch*) { assert(false); return 0; }
+};
+
+template<class InputStream, class T>
+void load_stream(InputStream& is, T& result)
+{
+    allocator pool(detail::capacity_hints<T>::chunk_size());
+    rapidjson::Document doc(&pool);
+    if (rapidjson::ParseResult pr = doc.ParseStream(is); pr.IsError())
+        throw parse_exception(pr);
+    detail::capacity_hints<T>::dom.update(pool.Size());
+    detail::convert_root(doc, result, {});
+}
+
+template<class T>
+T loads(std::span<const std::span<const char>> segments)
+{
+    if (segments.size() == 1)
+        return loads<T>(std::string_view{ segments[0].data(), segments[0].size() });
+    segmented_stream is(segments);
+    T result;
+    load_stream(is, result);
+    return result;
+}
+
+template<class T>
+void load(std::istream& str, T& result)
+{
+    rapidjson::IStreamWrapper strw(str);
+    load_stream(strw, result);
+}
+template<class T>
+T load(std::istream& str)
+{
+    T result;
+    load(str, result);
+    return result;
+}
+
+template<class T>
+T loads(std::string_view str, const load_options& options)
+{
+    detail::load_options_scope scope(options);
+    return loads<T>(str);
+}
+template<class T>
+void load(std::istream& str, T& result, const load_options& options)
+{
+    detail::load_options_scope scope(options);
+    load(str, result);
+}
+
+namespace detail
+{
+struct blob_field
+{
+    std::vector<const char*> path;
+    blob_sink* sink;
+};
+
+// IO object which finds the blob_sink fields of an object and of the objects nested in it
+class blob_finder
+{
+    std::vector<blob_field>& _blobs;
+    std::vector<const char*> _path;
+public:
+    explicit blob_finder(std::vector<blob_field>& blobs) : _blobs(blobs) {}
+    blob_finder& operator()([[maybe_unused]] const char* name) { return *this; }
+    template<class T, class... Default>
+    blob_finder& operator()(const char* name, T&& value, const Default&...)
+    {
+        using type = std::remove_cvref_t<T>;
+        if constexpr (std::is_same_v<type, blob_sink>)
+        {
+            _path.push_back(name);
+            _blobs.push_back({ _path, &value });
+            _path.pop_back();
+        }
+        else if constexpr (struct_like<type> && std::is_lvalue_reference_v<T>)
+        {
+            _path.push_back(name);
+            value.serialization(*this);
+            _path.pop_back();
+        }
+        return *this;
+    }
+};
+
+// rapidjson input stream which can take the string value of a blob field straight from the input: the value is
+// unescaped into the sink chunk by chunk, and the reader is shown null in its place
+template<class InputStream>
+class blob_stream
+{
+    InputStream& _is;
+    std::string_view _injected;
+    std::unique_ptr<char[]> _chunk;
+    size_t _size = 0;
+
+    void skip_ws()
+    {
+        while (_is.Peek() == ' ' || _is.Peek() == '\t' || _is.Peek() == '\n' || _is.Peek() == '\r')
+            _is.Take();
+    }
+    [[noreturn]] JSON_DTO_COLD void fail(const char* what) const
+    {
+        throw parse_exception(std::string(what) + " in blob at offset " + std::to_string(_is.Tell()));
+    }
+    void put(blob_sink& sink, char c)
+    {
+        _chunk[_size++] = c;
+        if (_size == blob_sink::chunk_size)
+        {
+            sink.write(_chunk.get(), _size);
+            _size = 0;
+        }
+    }
+    void put_utf8(blob_sink& sink, uint32_t cp)
+    {
+        if (cp < 0x80)
+            put(sink, (char)cp);
+        else if (cp < 0x800)
+        {
+            put(sink, (char)(0xC0 | (cp >> 6)));
+            put(sink, (char)(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000)
+        {
+            put(sink, (char)(0xE0 | (cp >> 12)));
+            put(sink, (char)(0x80 | ((cp >> 6) & 0x3F)));
+            put(sink, (char)(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            put(sink, (char)(0xF0 | (cp >> 18)));
+            put(sink, (char)(0x80 | ((cp >> 12) & 0x3F)));
+            put(sink, (char)(0x80 | ((cp >> 6) & 0x3F)));
+            put(sink, (char)(0x80 | (cp & 0x3F)));
+        }
+    }
+    uint32_t hex4()
+    {
+        uint32_t cp = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            const char c = _is.Take();
+            cp <<= 4;
+            if (c >= '0' && c <= '9')
+                cp |= (uint32_t)(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                cp |= (uint32_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                cp |= (uint32_t)(c - 'A' + 10);
+            else
+                fail("Invalid unicode escape");
+        }
+        return cp;
+    }
+    // The escape after a backslash, other than \u
+    char unescape(char c) const
+    {
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            return c;
+        case 'b':
+            return '\b';
+        case 'f':
+            return '\f';
+        case 'n':
+            return '\n';
+        case 'r':
+            return '\r';
+        case 't':
+            return '\t';
+        default:
+            fail("Invalid escape");
+        }
+    }
+public:
+    using Ch = char;
+    explicit blob_stream(InputStream& is) : _is(is) {}
+
+    Ch Peek() const { return _injected.empty() ? _is.Peek() : _injected.front(); }
+    Ch Take()
+    {
+        if (_injected.empty())
+            return _is.Take();
+        const Ch c = _injected.front();
+        _injected.remove_prefix(1);
+        return c;
+    }
+    size_t Tell() const { return _is.Tell(); }
+
+    // Called right after the key of a blob field; values other than strings are left to the reader
+    void take_string(blob_sink& sink)
+    {
+        skip_ws();
+        if (_is.Peek() != ':')
+            return;
+        _is.Take();
+        skip_ws();
+        if (_is.Peek() != '"')
+        {
+            _injected = ":";
+            return;
+        }
+        _is.Take();
+        if (!_chunk)
+            _chunk.reset(new char[blob_sink::chunk_size]);
+        for (;;)
+        {
+            const char c = _is.Take();
+            if (c == '"')
+                break;
+            if (c == '\\')
+            {
+                const char e = _is.Take();
+                if (e != 'u')
+                {
+                    put(sink, unescape(e));
+                    continue;
+                }
+                uint32_t cp = hex4();
+                if (cp >= 0xD800 && cp <= 0xDBFF)
+                {
+                    if (_is.Take() != '\\' || _is.Take() != 'u')
+                        fail("Unpaired surrogate");
+                    const uint32_t low = hex4();
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        fail("Unpaired surrogate");
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (cp >= 0xDC00 && cp <= 0xDFFF)
+                    fail("Unpaired surrogate");
+                put_utf8(sink, cp);
+            }
+            else if (c == '\0')
+                fail("Unterminated string");
+            else if ((unsigned char)c < 0x20)
+                fail("Invalid character");
+            else
+                put(sink, c);
+        }
+        if (_size != 0)
+            sink.write(_chunk.get(), _size);
+        _size = 0;
+        sink.finish();
+        _injected = ":null";
+    }
+
+    Ch* PutBegin() { assert(false); return nullptr; }
+    void Put(Ch) { assert(false); }
+    void Flush() { assert(false); }
+    size_t PutEnd(Ch*) { assert(false); return 0; }
+};
+
+// SAX handler which has the string values at the paths of blob fields passed to their sinks by the stream,
+// so neither the reader nor the DOM ever holds them
+template<class Handler, class Stream>
+class blob_handler
+{
+    struct frame
+    {
+        bool object = false;
+        std::string key;
+    };
+    Handler& _h;
+    Stream& _stream;
+    const std::vector<blob_field>& _blobs;
+    std::vector<frame> _frames;
+    size_t _depth = 0;
+
+    bool push(bool object)
+    {
+        if (_depth == _frames.size())
+            _frames.emplace_back();
+        _frames[_depth++].object = object;
+        return true;
+    }
+    blob_sink* find() const
+    {
+        for (const auto& blob : _blobs)
+        {
+            if (blob.path.size() != _depth)
+                continue;
+            bool match = true;
+            for (size_t i = 0; i < _depth && match; ++i)
+                match = _frames[i].object && _frames[i].key == blob.path[i];
+            if (match)
+                return blob.sink;
+        }
+        return nullptr;
+    }
+public:
+    blob_handler(Handler& h, Stream& stream, const std::vector<blob_field>& blobs) : _h(h), _stream(stream), _blobs(blobs) {}
+    bool Null() { return _h.Null(); }
+    bool Bool(bool b) { return _h.Bool(b); }
+    bool Int(int i) { return _h.Int(i); }
+    bool Uint(unsigned i) { return _h.Uint(i); }
+    bool Int64(int64_t i) { return _h.Int64(i); }
+    bool Uint64(uint64_t i) { return _h.Uint64(i); }
+    bool Double(double d) { return _h.Double(d); }
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy) { return _h.RawNumber(str, length, copy); }
+    bool String(const char* str, rapidjson::SizeType length, bool copy) { return _h.String(str, length, copy); }
+    bool StartObject() { return push(true) && _h.StartObject(); }
+    bool Key(const char* str, rapidjson::SizeType length, bool copy)
+    {
+        _frames[_depth - 1].key.assign(str, length);
+        if (!_h.Key(str, length, copy))
+            return false;
+        if (auto* sink = find())
+            _stream.take_string(*sink);
+        return true;
+    }
+    bool EndObject(rapidjson::SizeType count)
+    {
+        --_depth;
+        return _h.EndObject(count);
+    }
+    bool StartArray() { return push(false) && _h.StartArray(); }
+    bool EndArray(rapidjson::SizeType count)
+    {
+        --_depth;
+        return _h.EndArray(count);
+    }
+};
+}
+
+// Loads into result, passing the values of its blob_sink fields to the sinks already set in result while parsing:
+// they are unescaped from the input in chunks, so neither the reader nor the DOM holds them.
+// Blobs inside arrays, maps or optional values are delivered from the DOM after parsing instead.
+template<class InputStream, class T>
+void load_stream_blobs(InputStream& is, T& result)
+{
+    std::vector<detail::blob_field> blobs;
+    detail::blob_finder finder{ blobs };
+    result.serialization(finder);
+    allocator pool(detail::capacity_hints<T>::chunk_size());
+    rapidjson::Document doc(&pool);
+    rapidjson::ParseResult pr;
+    auto generator = [&](rapidjson::Document& handler)
+    {
+        detail::blob_stream<InputStream> stream(is);
+        detail::blob_handler<rapidjson::Document, detail::blob_stream<InputStream>> h(handler, stream, blobs);
+        rapidjson::Reader reader;
+        pr = reader.Parse(stream, h);
+        return !pr.IsError();
+    };
+    doc.Populate(generator);
+    if (pr.IsError())
+        throw parse_exception(pr);
+    detail::capacity_hints<T>::dom.update(pool.Size());
+    detail::convert_root(doc, result, {});
+}
+template<class T>
+void load_blobs(std::istream& str, T& result)
+{
+    rapidjson::IStreamWrapper strw(str);
+    load_stream_blobs(strw, result);
+}
+
+// Limits of the arrays converted by loads_preview
+struct array_limit
+{
+    size_t max_elements = std::numeric_limits<size_t>::max();
+    // Keep every k-th element, starting with the first
+    size_t sample_every = 1;
+};
+
+struct read_options
+{
+    // Limits of every array
+    array_limit arrays;
+    // Limits of the arrays at the given JSON Pointers, instead of arrays
+    std::vector<std::pair<std::string, array_limit>> paths;
+};
+
+// Array which was cut: its JSON Pointer, its true length and the number of elements converted
+struct truncated_array
+{
+    std::string pointer;
+    size_t length;
+    size_t kept;
+};
+
+template<class T>
+struct preview
+{
+    T value;
+    std::vector<truncated_array> truncated;
+};
+
+namespace detail
+{
+// rapidjson input stream over text which can jump over array elements with structural scanning
+class skipping_stream
+{
+    std::string_view _s;
+    size_t _pos = 0;
+public:
+    using Ch = char;
+    explicit skipping_stream(std::string_view s) : _s(s) {}
+
+    Ch Peek() const { return _pos < _s.size() ? _s[_pos] : '\0'; }
+    Ch Take() { return _pos < _s.size() ? _s[_pos++] : '\0'; }
+    size_t Tell() const { return _pos; }
+
+    // Skips up to n elements of the array the stream is in, after an element or, if first, right after '['
+    size_t skip_elements(size_t n, bool first)
+    {
+        size_t skipped = 0;
+        size_t pos = _pos;
+        if (first)
+        {
+            pos = skip_ws(_s, pos);
+            if (pos >= _s.size() || _s[pos] == ']')
+                return 0;
+            pos = skip_value(_s, pos);
+            ++skipped;
+        }
+        while (skipped < n)
+        {
+            size_t next = skip_ws(_s, pos);
+            if (next >= _s.size() || _s[next] != ',')
+                break;
+            pos = skip_value(_s, skip_ws(_s, next + 1));
+            ++skipped;
+        }
+        _pos = pos;
+        return skipped;
+    }
+
+    Ch* PutBegin() { assert(false); return nullptr; }
+    void Put(Ch) { assert(false); }
+    void Flush() { assert(false); }
+    size_t PutEnd(Ch*) { assert(false); return 0; }
+};
+
+// SAX handler which keeps the elements of arrays allowed by the limits and makes the stream skip the others
+template<class Handler>
+class array_limiter
+{
+    struct frame
+    {
+        bool object = false;
+        std::string key;
+        // Array: elements passed in the text, elements kept and the limits
+        size_t index = 0;
+        size_t kept = 0;
+        array_limit limit;
+    };
+    Handler& _h;
+    skipping_stream& _is;
+    const read_options& _options;
+    std::vector<truncated_array>& _truncated;
+    std::vector<frame> _frames;
+    size_t _depth = 0;
+
+    std::string pointer() const
+    {
+        std::string result;
+        for (size_t i = 0; i + 1 < _depth; ++i)
+        {
+            result += '/';
+            if (!_frames[i].object)
+                result += std::to_string(_frames[i].index);
+            else
+                for (char c : _frames[i].key)
+                    result += c == '~' ? "~0" : c == '/' ? "~1" : std::string(1, c);
+        }
+        return result;
+    }
+    frame& push(bool object)
+    {
+        if (_depth == _frames.size())
+            _frames.emplace_back();
+        auto& f = _frames[_depth++];
+        f.object = object;
+        f.index = f.kept = 0;
+        return f;
+    }
+    // Called when a value is complete, skips the elements which follow it if its array is over a limit
+    bool value_done()
+    {
+        if (_depth == 0 || _frames[_depth - 1].object)
+            return true;
+        auto& f = _frames[_depth - 1];
+        ++f.index;
+        ++f.kept;
+        if (f.kept >= f.limit.max_elements)
+            f.index += _is.skip_elements(std::numeric_limits<size_t>::max(), false);
+        else if (f.limit.sample_every > 1)
+            f.index += _is.skip_elements(f.limit.sample_every - 1, false);
+        return true;
+    }
+public:
+    array_limiter(Handler& h, skipping_stream& is, const read_options& options, std::vector<truncated_array>& truncated) :
+        _h(h), _is(is), _options(options), _truncated(truncated) {}
+    bool Null() { return _h.Null() && value_done(); }
+    bool Bool(bool b) { return _h.Bool(b) && value_done(); }
+    bool Int(int i) { return _h.Int(i) && value_done(); }
+    bool Uint(unsigned i) { return _h.Uint(i) && value_done(); }
+    bool Int64(int64_t i) { return _h.Int64(i) && value_done(); }
+    bool Uint64(uint64_t i) { return _h.Uint64(i) && value_done(); }
+    bool Double(double d) { return _h.Double(d) && value_done(); }
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy) { return _h.RawNumber(str, length, copy) && value_done(); }
+    bool String(const char* str, rapidjson::SizeType length, bool copy) { return _h.String(str, length, copy) && value_done(); }
+    bool StartObject()
+    {
+        push(true);
+        return _h.StartObject();
+    }
+    bool Key(const char* str, rapidjson::SizeType length, bool copy)
+    {
+        _frames[_depth - 1].key.assign(str, length);
+        return _h.Key(str, length, copy);
+    }
+    bool EndObject(rapidjson::SizeType count)
+    {
+        --_depth;
+        return _h.EndObject(count) && value_done();
+    }
+    bool StartArray()
+    {
+        auto& f = push(false);
+        f.limit = _options.arrays;
+        if (!_options.paths.empty())
+        {
+            const auto here = pointer();
+            for (const auto& [path, limit] : _options.paths)
+                if (path == here)
+                    f.limit = limit;
+        }
+        if (f.limit.max_elements == 0)
+            f.index = _is.skip_elements(std::numeric_limits<size_t>::max(), true);
+        return _h.StartArray();
+    }
+    bool EndArray(rapidjson::SizeType count)
+    {
+        const auto& f = _frames[_depth - 1];
+        if (f.index != f.kept)
+            _truncated.push_back({ pointer(), f.index, f.kept });
+        --_depth;
+        return _h.EndArray(count) && value_done();
+    }
+};
+}
+
+// Loads a preview of a big document: arrays are cut to the limits of options, and the elements left out
+// are passed over by structural scanning without being parsed or converted.
+// The true lengths of the cut arrays are reported; error locations refer to the kept elements.
+template<class T>
+preview<T> loads_preview(std::string_view str, const read_options& options)
+{
+    preview<T> result;
+    rapidjson::Document doc;
+    detail::skipping_stream is(str);
+    rapidjson::ParseResult pr;
+    auto generator = [&](rapidjson::Document& handler)
+    {
+        detail::array_limiter<rapidjson::Document> h(handler, is, options, result.truncated);
+        rapidjson::Reader reader;
+        pr = reader.Parse(is, h);
+        return !pr.IsError();
+    };
+    doc.Populate(generator);
+    if (pr.IsError())
+        throw parse_exception(pr);
+    detail::convert_root(doc, result.value, {});
+    return result;
+}
+
+// Memory of the DOM built by a load: the pool first uses buffer, then allocates chunks of chunk_size
+struct allocator_options
+{
+    size_t chunk_size = 64 * 1024;
+    std::span<char> buffer;
+
+    allocator make_allocator() const
+    {
+        if (buffer.empty())
+            return allocator(chunk_size);
+        return allocator(buffer.data(), buffer.size(), chunk_size);
+    }
+};
+
+#if defined(JSON_DTO_HAS_MMAN)
+// Anonymous mapping aligned to and advised for transparent huge pages, released with one munmap.
+// Give it to allocator_options::buffer with about the size of the expected DOM.
+class huge_page_buffer
+{
+    static constexpr size_t huge_page = 2u << 20;
+    char* _data = nullptr;
+    size_t _size = 0;
+public:
+    explicit huge_page_buffer(size_t size)
+    {
+        _size = (size + huge_page - 1) / huge_page * huge_page;
+        const size_t mapped = _size + huge_page;
+        void* p = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        auto* begin = static_cast<char*>(p);
+        _data = begin + (huge_page - (uintptr_t)begin % huge_page) % huge_page;
+        if (_data != begin)
+            ::munmap(begin, (size_t)(_data - begin));
+        if (const size_t tail = (size_t)(begin + mapped - (_data + _size)); tail != 0)
+            ::munmap(_data + _size, tail);
+#if defined(MADV_HUGEPAGE)
+        ::madvise(_data, _size, MADV_HUGEPAGE);
+#endif
+    }
+    huge_page_buffer(const huge_page_buffer&) = delete;
+    huge_page_buffer& operator=(const huge_page_buffer&) = delete;
+    ~huge_page_buffer() { ::munmap(_data, _size); }
+    std::span<char> span() const { return { _data, _size }; }
+};
+#endif
+
+class memory_budget_exceeded : public std::bad_alloc
+{
+public:
+    [[nodiscard]] char const* what() const noexcept override { return "Memory budget exceeded"; }
+};
+
+// Memory resource which refuses to hold more than limit bytes at once, for one load call.
+// Containers of the loaded value use it when the value is allocator-aware (std::pmr containers, or DTOs with
+// allocator_type), and their allocator-aware elements inherit it by uses-allocator construction.
+// The bytes requested through it are counted, so upstream should not pool them into bigger blocks of its own.
+class budget_resource : public std::pmr::memory_resource
+{
+    std::pmr::memory_resource* _upstream;
+    size_t _limit;
+    size_t _used = 0;
+public:
+    explicit budget_resource(size_t limit, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+        _upstream(upstream),
+        _limit(limit)
+    {}
+    size_t limit() const { return _limit; }
+    size_t used() const { return _used; }
+    bool fits(size_t bytes) const { return bytes <= _limit - _used; }
+    // Accounts memory held elsewhere, e.g. by the DOM while it is converted
+    void charge(size_t bytes)
+    {
+        if (!fits(bytes))
+            throw memory_budget_exceeded();
+        _used += bytes;
+    }
+    void discharge(size_t bytes) { _used -= bytes; }
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        charge(bytes);
+        try
+        {
+            return _upstream->allocate(bytes, alignment);
+        }
+        catch (...)
+        {
+            discharge(bytes);
+            throw;
+        }
+    }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        _upstream->deallocate(p, bytes, alignment);
+        discharge(bytes);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+namespace detail
+{
+// rapidjson allocator for the parse stacks of the reader and the document, which takes their memory from a
+// memory resource. Free is static in rapidjson's allocator concept, so each block starts with its resource and size.
+class resource_stack_allocator
 {
-    using backend_type = std::decay_t<decltype(std::declval<WB>().get_backend())>;
-    static bool get(value_c v, WB& value)
+    struct header
     {
-        return adapter<backend_type>::get(v, value.get_backend());
+        std::pmr::memory_resource* resource;
+        size_t size;
+    };
+    static constexpr size_t header_size = (sizeof(header) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    std::pmr::memory_resource* _resource = std::pmr::new_delete_resource();
+public:
+    static const bool kNeedFree = true;
+    resource_stack_allocator() = default;
+    explicit resource_stack_allocator(std::pmr::memory_resource* resource) : _resource(resource) {}
+
+    void* Malloc(size_t size)
+    {
+        if (size == 0)
+            return nullptr;
+        char* block = static_cast<char*>(_resource->allocate(header_size + size, alignof(std::max_align_t)));
+        ::new (block) header{ _resource, size };
+        return block + header_size;
     }
-    static void set(allocator& a, value_r v, const WB& value)
+    // A new block is taken before the old one is released, so the budget sees both while the stack grows
+    void* Realloc(void* original, size_t, size_t size)
     {
-        adapter<backend_type>::set(a, v, value.get_backend());
+        if (size == 0)
+        {
+            Free(original);
+            return nullptr;
+        }
+        void* result = Malloc(size);
+        if (original)
+        {
+            std::memcpy(result, original, std::min(size, reinterpret_cast<header*>(static_cast<char*>(original) - header_size)->size));
+            Free(original);
+        }
+        return result;
+    }
+    static void Free(void* p)
+    {
+        if (!p)
+            return;
+        char* block = static_cast<char*>(p) - header_size;
+        const header h = *reinterpret_cast<header*>(block);
+        h.resource->deallocate(block, header_size + h.size, alignof(std::max_align_t));
     }
 };
 
-template<class T>
-const json_reader& json_reader::operator()(const char* name, T& value) const
+// Memory held outside a budget_resource, e.g. by the DOM pool, charged to it until destruction
+class budget_charge
 {
-    auto member = _v.FindMember(name);
-    if (member == _v.MemberEnd())
-        throw parse_exception(std::string("Field not found: ") + name + " in type " + _type_name );
-    if (!adapter<T>::get(member->value, value))
-        throw parse_exception(std::string("Cannot parse field: ") + name + " in type " + _type_name);
-    return *this;
-}
-template<class T>
-const json_reader& json_reader::operator()(const char* name, std::decay_t<T>* p_value) const
+    budget_resource& _budget;
+    size_t _bytes = 0;
+public:
+    explicit budget_charge(budget_resource& budget) : _budget(budget) {}
+    budget_charge(const budget_charge&) = delete;
+    budget_charge& operator=(const budget_charge&) = delete;
+    ~budget_charge() { _budget.discharge(_bytes); }
+    budget_resource& budget() const { return _budget; }
+    // The held memory has grown to bytes
+    void update(size_t bytes)
+    {
+        if (bytes > _bytes)
+        {
+            _budget.charge(bytes - _bytes);
+            _bytes = bytes;
+        }
+    }
+};
+
+// SAX handler which forwards events to the document and throws memory_budget_exceeded before the document takes
+// memory from its pool that the budget has no room for. The pool grows by whole chunks, so each event which copies
+// into the pool needs room for a new chunk of max(chunk_size, its bytes), and the chunks are charged as they are added.
+// Strings are checked by their length, before the document copies them.
+template<class Handler>
+class budgeted_handler
 {
-    if (p_value == nullptr)
-        return *this;
-    auto member = _v.FindMember(name);
-    if (member == _v.MemberEnd())
-        throw parse_exception(std::string("Field not found: ") + name + " in type " + _type_name);
-    if (!adapter<T>::get(member->value, *p_value))
-        throw parse_exception(std::string("Cannot parse field: ") + name + " in type " + _type_name);
-    return *this;
-}
-template<class T, std::convertible_to<T> TT>
-    requires(!std::assignable_from<T, TT>)
-const json_reader& json_reader::operator()(const char* name, T& value, const TT& default_value) const
+    Handler& _h;
+    const allocator& _pool;
+    size_t _chunk_size;
+    budget_charge& _charge;
+
+    void reserve(size_t bytes) const
+    {
+        if (!_charge.budget().fits(std::max(_chunk_size, (size_t)RAPIDJSON_ALIGN(bytes))))
+            throw memory_budget_exceeded();
+    }
+    bool charged(bool result)
+    {
+        _charge.update(_pool.Capacity());
+        return result;
+    }
+public:
+    budgeted_handler(Handler& h, const allocator& pool, size_t chunk_size, budget_charge& charge) :
+        _h(h), _pool(pool), _chunk_size(chunk_size), _charge(charge) {}
+    bool Null() { return _h.Null(); }
+    bool Bool(bool b) { return _h.Bool(b); }
+    bool Int(int i) { return _h.Int(i); }
+    bool Uint(unsigned i) { return _h.Uint(i); }
+    bool Int64(int64_t i) { return _h.Int64(i); }
+    bool Uint64(uint64_t i) { return _h.Uint64(i); }
+    bool Double(double d) { return _h.Double(d); }
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy)
+    {
+        reserve((size_t)length + 1);
+        return charged(_h.RawNumber(str, length, copy));
+    }
+    bool String(const char* str, rapidjson::SizeType length, bool copy)
+    {
+        reserve((size_t)length + 1);
+        return charged(_h.String(str, length, copy));
+    }
+    bool StartObject() { return _h.StartObject(); }
+    bool Key(const char* str, rapidjson::SizeType length, bool copy)
+    {
+        reserve((size_t)length + 1);
+        return charged(_h.Key(str, length, copy));
+    }
+    bool EndObject(rapidjson::SizeType count)
+    {
+        reserve((size_t)count * sizeof(rapidjson::Value::Member));
+        return charged(_h.EndObject(count));
+    }
+    bool StartArray() { return _h.StartArray(); }
+    bool EndArray(rapidjson::SizeType count)
+    {
+        reserve((size_t)count * sizeof(rapidjson::Value));
+        return charged(_h.EndArray(count));
+    }
+};
+
+template<class T>
+T make_budgeted(budget_resource& budget)
 {
-    if (auto member = _v.FindMember(name); member == _v.MemberEnd())
-        value = static_cast<T>(default_value);
-    else if (!adapter<T>::get(member->value, value))
-        throw parse_exception(std::string("Cannot parse field: ") + name + " in type " + _type_name);
-    return *this;
+    if constexpr (std::uses_allocator_v<T, std::pmr::polymorphic_allocator<>>)
+        return std::make_obj_using_allocator<T>(std::pmr::polymorphic_allocator<>(&budget));
+    else
+        return T{};
 }
-template<class TT, std::assignable_from<TT> T>
-const json_reader& json_reader::operator()(const char* name, T& value, const TT& default_value) const
-{
-    if (auto member = _v.FindMember(name); member == _v.MemberEnd())
-        value = default_value;
-    else if (!adapter<T>::get(member->value, value))
-        throw parse_exception(std::string("Cannot parse field: ") + name + " in type " + _type_name);
-    return *this;
 }
-template<class T, class TT>
-    requires std::is_convertible_v<std::invoke_result_t<TT>, T>
-const json_reader& json_reader::operator()(const char* name, std::decay_t<T>& value, TT default_value_maker) const
+
+// Loads with a hard memory limit shared by the parse stacks, the DOM and the allocator-aware containers of the result.
+// Throws memory_budget_exceeded before an allocation would exceed the limit; everything allocated by the call is
+// released by then. Near the limit a load may be refused up to one DOM pool chunk early; small budgets get small
+// chunks, which keeps that margin small.
+template<class T>
+T loads(std::string_view str, budget_resource& budget)
 {
-    if (auto member = _v.FindMember(name); member == _v.MemberEnd())
-        value = static_cast<T>(default_value_maker());
-    else if (!adapter<T>::get(member->value, value))
-        throw parse_exception(std::string("Cannot parse field: ") + name + " in type " + _type_name);
-    return *this;
+    const size_t chunk_size = std::clamp<size_t>(budget.limit() / 16, 1024, 64 * 1024);
+    detail::budget_charge dom(budget);
+    allocator pool(chunk_size);
+    detail::resource_stack_allocator stacks(&budget);
+    // 1024 and 256 are rapidjson's initial stack capacities of the document and the reader
+    rapidjson::GenericDocument<rapidjson::UTF8<>, allocator, detail::resource_stack_allocator> doc(&pool, 1024, &stacks);
+    rapidjson::ParseResult pr;
+    auto generator = [&](auto& handler)
+    {
+        detail::budgeted_handler h(handler, pool, chunk_size, dom);
+        rapidjson::MemoryStream is(str.data(), str.size());
+        rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>, detail::resource_stack_allocator> reader(&stacks, 256);
+        pr = reader.Parse(is, h);
+        return !pr.IsError();
+    };
+    doc.Populate(generator);
+    if (pr.IsError())
+        throw parse_exception(pr);
+
+    T result = detail::make_budgeted<T>(budget);
+    detail::convert_root(doc, result, str);
+    return result;
 }
 
 template<class T>
-T loads(std::string_view str)
+T loads(std::string_view str, const allocator_options& options)
 {
-    rapidjson::Document doc;
+    allocator pool = options.make_allocator();
+    rapidjson::Document doc(&pool);
     if (rapidjson::ParseResult pr = doc.Parse(str.data(), str.size()); pr.IsError())
         throw parse_exception(pr);
     T result;
-    if (!adapter<T>::get(doc, result))
-        throw parse_exception("Cannot convert the value");
+    detail::convert_root(doc, result, str);
     return result;
 }
-
 template<class T>
-void load(std::istream& str, T& result)
+void load(std::istream& str, T& result, const allocator_options& options)
 {
-    rapidjson::Document doc;
+    allocator pool = options.make_allocator();
+    rapidjson::Document doc(&pool);
     rapidjson::IStreamWrapper strw(str);
     if (rapidjson::ParseResult pr = doc.ParseStream(strw); pr.IsError())
         throw parse_exception(pr);
-    if(!adapter<T>::get(doc, result))
-        throw parse_exception("Cannot convert the value");
-}
-template<class T>
-T load(std::istream& str)
-{
-    T result;
-    load(str, result);
-    return result;
+    detail::convert_root(doc, result, {});
 }
 
 template<class T>
-json_writer& json_writer::operator()(const char* name, const T& value)
+void json_writer::write_member(const char* name, const T& value)
 {
+    if (_options.update)
+    {
+        if (auto member = _v.FindMember(name); member != _v.MemberEnd())
+        {
+            adapter<T>::set(_a, member->value, value);
+            if (_options.omit_empty && detail::is_omitted(member->value, detail::omitted_value<T>()))
+                _v.EraseMember(member);
+            return;
+        }
+    }
     rapidjson::Value key, v;
-    key.SetString(name, _a);
     adapter<T>::set(_a, v, value);
+    if (_options.omit_empty && detail::is_omitted(v, detail::omitted_value<T>()))
+        return;
+    if (_options.borrow_strings)
+        key.SetString(rapidjson::StringRef(name));
+    else
+        key.SetString(name, _a);
     _v.AddMember(key, v, _a);
+}
+template<class T>
+json_writer& json_writer::operator()(const char* name, const T& value)
+{
+    write_member(name, value);
     return *this;
 }
 template<class T>
 json_writer& json_writer::operator()(const char* name, const std::decay_t<T>* p_value)
 {
     if (p_value == nullptr)
-        return *this;
-    rapidjson::Value key, v;
-    key.SetString(name, _a);
-    adapter<T>::set(_a, v, *p_value);
-    _v.AddMember(key, v, _a);
+        skip_member(name);
+    else
+        write_member(name, *p_value);
     return *this;
 }
 template<class T, std::convertible_to<T> TT>
@@ -731,22 +3399,18 @@ template<class T, std::convertible_to<T> TT>
 json_writer& json_writer::operator()(const char* name, const T& value, TT default_value)
 {
     if (value == (T)default_value)
-        return *this;
-    rapidjson::Value key, v;
-    key.SetString(name, _a);
-    adapter<std::remove_cv_t<T>>::set(_a, v, value);
-    _v.AddMember(key, v, _a);
+        skip_member(name);
+    else
+        write_member<std::remove_cv_t<T>>(name, value);
     return *this;
 }
 template<class T, has_equal_with<T> TT>
 json_writer& json_writer::operator()(const char* name, const T& value, TT default_value)
 {
     if (value == default_value)
-        return *this;
-    rapidjson::Value key, v;
-    key.SetString(name, _a);
-    adapter<std::remove_cv_t<T>>::set(_a, v, value);
-    _v.AddMember(key, v, _a);
+        skip_member(name);
+    else
+        write_member<std::remove_cv_t<T>>(name, value);
     return *this;
 }
 template<class T, class TT>
@@ -756,27 +3420,391 @@ json_writer& json_writer::operator()(const char* name, const T& value, TT defaul
     return operator()(name, value, default_value_maker());
 }
 
+namespace detail
+{
+// Position of the first character of s which must be escaped in a JSON string, size if there is none
+inline size_t find_escape_scalar(const char* s, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        const auto c = (unsigned char)s[i];
+        if (c < 0x20 || c == '"' || c == '\\')
+            return i;
+    }
+    return size;
+}
+
+#if defined(JSON_DTO_HAS_X86_DISPATCH)
+__attribute__((target("sse2"))) inline size_t find_escape_sse2(const char* s, size_t size)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        // max(x, 0x1F) == 0x1F is the unsigned x < 0x20
+        const __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(x, control), control));
+        if (const auto mask = (unsigned)_mm_movemask_epi8(hit))
+            return i + (size_t)std::countr_zero(mask);
+    }
+    return i + find_escape_scalar(s + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline size_t find_escape_avx2(const char* s, size_t size)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        const __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(x, control), control));
+        if (const auto mask = (uint32_t)_mm256_movemask_epi8(hit))
+            return i + (size_t)std::countr_zero(mask);
+    }
+    return i + find_escape_sse2(s + i, size - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline size_t find_escape_avx512(const char* s, size_t size)
+{
+    const __m512i quote = _mm512_set1_epi8('"');
+    const __m512i backslash = _mm512_set1_epi8('\\');
+    const __m512i space = _mm512_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+    {
+        const __m512i x = _mm512_loadu_si512(s + i);
+        const __mmask64 hit = _mm512_cmpeq_epi8_mask(x, quote) | _mm512_cmpeq_epi8_mask(x, backslash) | _mm512_cmplt_epu8_mask(x, space);
+        if (hit)
+            return i + (size_t)std::countr_zero((uint64_t)hit);
+    }
+    return i + find_escape_avx2(s + i, size - i);
+}
+#elif defined(JSON_DTO_HAS_NEON)
+inline size_t find_escape_neon(const char* s, size_t size)
+{
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const uint8x16_t x = vld1q_u8(reinterpret_cast<const uint8_t*>(s + i));
+        const uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(x, quote), vceqq_u8(x, backslash)), vcltq_u8(x, space));
+        if (vmaxvq_u8(hit))
+            return i + find_escape_scalar(s + i, 16);
+    }
+    return i + find_escape_scalar(s + i, size - i);
+}
+#endif
+
+using find_escape_fn = size_t (*)(const char*, size_t);
+
+// Picks the widest implementation the CPU supports once, so one binary runs optimally across machines
+inline find_escape_fn select_find_escape()
+{
+#if defined(JSON_DTO_HAS_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+        return find_escape_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return find_escape_avx2;
+    return find_escape_sse2;
+#elif defined(JSON_DTO_HAS_NEON)
+    return find_escape_neon;
+#else
+    return find_escape_scalar;
+#endif
+}
+
+inline size_t find_escape(const char* s, size_t size)
+{
+    static const find_escape_fn f = select_find_escape();
+    return f(s, size);
+}
+
+template<class OutputStream>
+void put_run(OutputStream& os, const char* s, size_t size)
+{
+    if constexpr (requires { os.Push(size); })
+        std::memcpy(os.Push(size), s, size);
+    else
+        for (size_t i = 0; i < size; ++i)
+            os.Put(s[i]);
+}
+}
+
+// rapidjson writer which copies escape-free runs of strings at once, finding them with vector instructions
+template<class OutputStream>
+class writer : public rapidjson::Writer<OutputStream>
+{
+    using base = rapidjson::Writer<OutputStream>;
+
+    bool write_string(const char* str, size_t length)
+    {
+        static constexpr char hex[] = "0123456789ABCDEF";
+        OutputStream& os = *base::os_;
+        os.Put('"');
+        for (size_t pos = 0;;)
+        {
+            const size_t run = detail::find_escape(str + pos, length - pos);
+            detail::put_run(os, str + pos, run);
+            pos += run;
+            if (pos == length)
+                break;
+            const auto c = (unsigned char)str[pos++];
+            os.Put('\\');
+            switch (c)
+            {
+            case '"':
+            case '\\':
+                os.Put((char)c);
+                break;
+            case '\b':
+                os.Put('b');
+                break;
+            case '\f':
+                os.Put('f');
+                break;
+            case '\n':
+                os.Put('n');
+                break;
+            case '\r':
+                os.Put('r');
+                break;
+            case '\t':
+                os.Put('t');
+                break;
+            default:
+                os.Put('u');
+                os.Put('0');
+                os.Put('0');
+                os.Put(hex[c >> 4]);
+                os.Put(hex[c & 0xF]);
+            }
+        }
+        os.Put('"');
+        return true;
+    }
+public:
+    using base::base;
+    using base::String;
+    using base::Key;
+    bool String(const char* str, rapidjson::SizeType length, [[maybe_unused]] bool copy = false)
+    {
+        base::Prefix(rapidjson::kStringType);
+        return base::EndValue(write_string(str, length));
+    }
+    bool Key(const char* str, rapidjson::SizeType length, [[maybe_unused]] bool copy = false)
+    {
+        base::Prefix(rapidjson::kStringType);
+        return base::EndValue(write_string(str, length));
+    }
+};
+
+template<class OutputStream, class T>
+void dump_stream(OutputStream& os, const T& value)
+{
+    allocator pool(detail::capacity_hints<T>::chunk_size());
+    rapidjson::Document doc(&pool);
+    adapter<T>::set(pool, doc, value);
+    detail::capacity_hints<T>::dom.update(pool.Size());
+    writer<OutputStream> w(os);
+    doc.Accept(w);
+}
+
 template<class T>
 void dump(std::ostream& str, const T& value)
 {
-    rapidjson::Document doc;
-    adapter<T>::set(doc.GetAllocator(), doc, value);
     rapidjson::OStreamWrapper strw(str);
-    rapidjson::Writer<rapidjson::OStreamWrapper> writer(strw);
-    doc.Accept(writer);
+    dump_stream(strw, value);
 }
 
 template<class T>
 std::string dumps(const T& value)
 {
+    allocator pool(detail::capacity_hints<T>::chunk_size());
+    rapidjson::Document doc(&pool);
+    adapter<T>::set(pool, doc, value);
+    detail::capacity_hints<T>::dom.update(pool.Size());
+    const size_t text_hint = detail::capacity_hints<T>::text.get();
+    rapidjson::StringBuffer buffer(nullptr, text_hint ? text_hint : 256);
+    writer<rapidjson::StringBuffer> w(buffer);
+    doc.Accept(w);
+    detail::capacity_hints<T>::text.update(buffer.GetSize());
+    return { buffer.GetString(), buffer.GetSize() };
+}
+
+// Replaces the value addressed by a JSON Pointer with the serialized value, without parsing the rest of the document
+template<class T>
+std::string patch_text(std::string_view json, std::string_view pointer, const T& value)
+{
+    const auto [begin, end] = detail::locate(json, pointer);
+    const std::string text = dumps(value);
+    std::string result;
+    result.reserve(json.size() - (end - begin) + text.size());
+    result.append(json.substr(0, begin)).append(text).append(json.substr(end));
+    return result;
+}
+
+namespace detail
+{
+// SAX handler which forwards events to handler and stops at a container boundary when the limits are exceeded
+template<class Handler, class Stream>
+class cancellable_handler
+{
+    Handler& _h;
+    const Stream& _s;
+    const cancellation& _c;
+    bool proceed()
+    {
+        reason = _c.expired(_s.Tell());
+        return !reason;
+    }
+public:
+    std::optional<cancelled_exception::reason> reason;
+    cancellable_handler(Handler& h, const Stream& s, const cancellation& c) : _h(h), _s(s), _c(c) {}
+    bool Null() { return _h.Null(); }
+    bool Bool(bool b) { return _h.Bool(b); }
+    bool Int(int i) { return _h.Int(i); }
+    bool Uint(unsigned i) { return _h.Uint(i); }
+    bool Int64(int64_t i) { return _h.Int64(i); }
+    bool Uint64(uint64_t i) { return _h.Uint64(i); }
+    bool Double(double d) { return _h.Double(d); }
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy) { return _h.RawNumber(str, length, copy); }
+    bool String(const char* str, rapidjson::SizeType length, bool copy) { return _h.String(str, length, copy); }
+    bool StartObject() { return proceed() && _h.StartObject(); }
+    bool Key(const char* str, rapidjson::SizeType length, bool copy) { return _h.Key(str, length, copy); }
+    bool EndObject(rapidjson::SizeType count) { return _h.EndObject(count); }
+    bool StartArray() { return proceed() && _h.StartArray(); }
+    bool EndArray(rapidjson::SizeType count) { return _h.EndArray(count); }
+};
+
+// Output stream which counts the characters written through it.
+// The bulk writes of the wrapped stream are forwarded, so the writer keeps its fast paths for it.
+template<class OutputStream>
+class counting_stream
+{
+    OutputStream& _os;
+    size_t _count = 0;
+public:
+    using Ch = typename OutputStream::Ch;
+    explicit counting_stream(OutputStream& os) : _os(os) {}
+    void Put(Ch c) { ++_count; _os.Put(c); }
+    Ch* Push(size_t count) requires requires(OutputStream& os, size_t n) { os.Push(n); }
+    {
+        _count += count;
+        return _os.Push(count);
+    }
+    void Flush() { _os.Flush(); }
+    size_t Tell() const { return _count; }
+
+    // Found by rapidjson's writer through argument-dependent lookup
+    friend void PutReserve(counting_stream& s, size_t count) { rapidjson::PutReserve(s._os, count); }
+    friend void PutUnsafe(counting_stream& s, Ch c)
+    {
+        ++s._count;
+        rapidjson::PutUnsafe(s._os, c);
+    }
+    friend void PutN(counting_stream& s, Ch c, size_t n)
+    {
+        s._count += n;
+        rapidjson::PutN(s._os, c, n);
+    }
+};
+
+template<class InputStream>
+void parse_cancellable(rapidjson::Document& doc, InputStream& is, const cancellation& c)
+{
+    rapidjson::ParseResult pr;
+    std::optional<cancelled_exception::reason> reason;
+    auto generator = [&](rapidjson::Document& handler)
+    {
+        cancellable_handler<rapidjson::Document, InputStream> h(handler, is, c);
+        rapidjson::Reader reader;
+        pr = reader.Parse(is, h);
+        reason = h.reason;
+        return !pr.IsError();
+    };
+    doc.Populate(generator);
+    if (reason)
+        throw cancelled_exception(*reason);
+    if (pr.IsError())
+        throw parse_exception(pr);
+}
+
+template<class OutputStream, class T>
+void write_cancellable(OutputStream& os, const T& value, const cancellation& c)
+{
+    cancellation_scope scope(c);
     rapidjson::Document doc;
     adapter<T>::set(doc.GetAllocator(), doc, value);
+    counting_stream<OutputStream> counter(os);
+    writer<counting_stream<OutputStream>> w(counter);
+    cancellable_handler<decltype(w), counting_stream<OutputStream>> h(w, counter, c);
+    if (!doc.Accept(h) && h.reason)
+        throw cancelled_exception(*h.reason);
+}
+}
+
+// Loads which stop at the next container boundary with cancelled_exception
+// once c.stop is requested, c.deadline passes or more than c.max_bytes of input are consumed
+template<class T>
+T loads(std::string_view str, const cancellation& c)
+{
+    detail::cancellation_scope scope(c);
+    rapidjson::Document doc;
+    rapidjson::MemoryStream is(str.data(), str.size());
+    detail::parse_cancellable(doc, is, c);
+    T result;
+    detail::convert_root(doc, result, str);
+    return result;
+}
+template<class T>
+void load(std::istream& str, T& result, const cancellation& c)
+{
+    detail::cancellation_scope scope(c);
+    rapidjson::Document doc;
+    rapidjson::IStreamWrapper is(str);
+    detail::parse_cancellable(doc, is, c);
+    detail::convert_root(doc, result, {});
+}
+
+// Dumps which stop at the next container boundary with cancelled_exception
+// once c.stop is requested, c.deadline passes or more than c.max_bytes of output are produced
+template<class T>
+void dump(std::ostream& str, const T& value, const cancellation& c)
+{
+    rapidjson::OStreamWrapper strw(str);
+    detail::write_cancellable(strw, value, c);
+}
+template<class T>
+std::string dumps(const T& value, const cancellation& c)
+{
     rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    doc.Accept(writer);
+    detail::write_cancellable(buffer, value, c);
     return { buffer.GetString(), buffer.GetSize() };
 }
 
+// Dumps with the given write options, e.g. canonical output
+template<class T>
+void dump(std::ostream& str, const T& value, const write_options& options)
+{
+    detail::write_options_scope scope(options);
+    dump(str, value);
+}
+template<class T>
+std::string dumps(const T& value, const write_options& options)
+{
+    detail::write_options_scope scope(options);
+    return dumps(value);
+}
+
 template<class Func>
 class dto_wrapper
 {
@@ -837,6 +3865,7 @@ class as_json
     const DTO& _dto;
 public:
     explicit as_json(const DTO& dto) : _dto(dto) {}
+    const DTO& dto() const { return _dto; }
 
     friend std::ostream& operator<< (std::ostream& str, const as_json<DTO>& json)
     {
@@ -844,4 +3873,99 @@ public:
         return str;
     }
 };
+
+// rapidjson output stream which writes to an output iterator in small chunks
+template<std::output_iterator<char> OutIt>
+class iterator_sink
+{
+    OutIt _out;
+    char _buffer[256];
+    size_t _size = 0;
+public:
+    using Ch = char;
+    explicit iterator_sink(OutIt out) : _out(std::move(out)) {}
+    void Put(char c)
+    {
+        if (_size == sizeof(_buffer))
+            Flush();
+        _buffer[_size++] = c;
+    }
+    void Flush()
+    {
+        _out = std::copy_n(_buffer, _size, std::move(_out));
+        _size = 0;
+    }
+    OutIt out()
+    {
+        Flush();
+        return std::move(_out);
+    }
+};
+
+template<class DTO, class OutIt>
+OutIt dump_to(OutIt out, const DTO& value)
+{
+    iterator_sink<OutIt> sink(std::move(out));
+    dump_stream(sink, value);
+    return sink.out();
+}
+}
+
+#if defined(__cpp_lib_format)
+template<class DTO>
+struct std::formatter<json_dto::as_json<DTO>, char>
+{
+    constexpr auto parse(std::format_parse_context& ctx)
+    {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}')
+            throw std::format_error("json_dto::as_json does not support format specs");
+        return it;
+    }
+    template<class FormatContext>
+    auto format(const json_dto::as_json<DTO>& json, FormatContext& ctx) const
+    {
+        return json_dto::dump_to(ctx.out(), json.dto());
+    }
+};
+#endif
+
+#if defined(FMT_VERSION)
+template<class DTO>
+struct fmt::formatter<json_dto::as_json<DTO>, char>
+{
+    constexpr auto parse(fmt::format_parse_context& ctx)
+    {
+        auto it = ctx.begin();
+        if (it != ctx.end() && *it != '}')
+            throw fmt::format_error("json_dto::as_json does not support format specs");
+        return it;
+    }
+    template<class FormatContext>
+    auto format(const json_dto::as_json<DTO>& json, FormatContext& ctx) const
+    {
+        return json_dto::dump_to(ctx.out(), json.dto());
+    }
+};
+#endif
+
+// Table mode for DTOs whose serialization() only lists data members: instead of instantiating json_reader and
+// json_writer per type, the fields are recorded once in a table interpreted by a shared engine.
+// JSON_DTO_FIELD_TABLE(TYPE) goes next to the type, JSON_DTO_FIELD_TABLE_INSTANCE(TYPE) into exactly one source file.
+// Both must be used at global namespace scope, since they specialize json_dto::adapter; TYPE must then be fully qualified.
+#define JSON_DTO_FIELD_TABLE(TYPE) \
+template<> \
+struct json_dto::adapter<TYPE> \
+{ \
+    using struct_like = void; \
+    static const json_dto::detail::field_table& table(); \
+    static bool get(json_dto::value_c v, TYPE& value) { return json_dto::detail::read_fields(table(), v, &value); } \
+    static void set(json_dto::allocator& a, json_dto::value_r v, const TYPE& value) { json_dto::detail::write_fields(table(), a, v, &value); } \
+};
+
+#define JSON_DTO_FIELD_TABLE_INSTANCE(TYPE) \
+const json_dto::detail::field_table& json_dto::adapter<TYPE>::table() \
+{ \
+    static const json_dto::detail::field_table t = json_dto::detail::build_field_table<TYPE>(); \
+    return t; \
 }
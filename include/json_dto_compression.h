@@ -0,0 +1,367 @@
+#pragma once
+
+#include "json_dto.h"
+
+#include <memory>
+#include <stdexcept>
+
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define JSON_DTO_HAS_ZLIB 1
+#endif
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define JSON_DTO_HAS_ZSTD 1
+#endif
+
+namespace json_dto
+{
+#if defined(JSON_DTO_HAS_ZLIB)
+// rapidjson input stream which inflates gzip/zlib data from std::istream chunk by chunk
+class gzip_source
+{
+    std::istream& _in;
+    z_stream _z{};
+    size_t _chunk;
+    std::unique_ptr<char[]> _in_buf;
+    std::unique_ptr<char[]> _out_buf;
+    const char* _cur;
+    const char* _end;
+    size_t _base = 0;
+    bool _done = false;
+    bool _stream_end = false;
+    bool _out_full = false;
+
+    void fill()
+    {
+        _base += (size_t)(_end - _out_buf.get());
+        _cur = _end = _out_buf.get();
+        while (_cur == _end && !_done)
+        {
+            if (_z.avail_in == 0 && !_out_full)
+            {
+                _in.read(_in_buf.get(), (std::streamsize)_chunk);
+                _z.next_in = reinterpret_cast<Bytef*>(_in_buf.get());
+                _z.avail_in = (uInt)_in.gcount();
+                if (_z.avail_in == 0)
+                {
+                    _done = true;
+                    if (!_stream_end)
+                        throw parse_exception("Truncated gzip stream");
+                    break;
+                }
+            }
+            _z.next_out = reinterpret_cast<Bytef*>(_out_buf.get());
+            _z.avail_out = (uInt)_chunk;
+            const uInt avail_in = _z.avail_in;
+            const int rc = inflate(&_z, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR)
+                throw parse_exception(std::string("gzip: ") + (_z.msg ? _z.msg : "inflate error"));
+            // A member which ended with the output buffer full is followed by a call without progress;
+            // only data of a next member clears the end
+            if (rc == Z_STREAM_END)
+            {
+                _stream_end = true;
+                inflateReset(&_z);
+            }
+            else if (_z.avail_in != avail_in || _z.avail_out != _chunk)
+                _stream_end = false;
+            _out_full = _z.avail_out == 0;
+            _end = _out_buf.get() + (_chunk - _z.avail_out);
+        }
+    }
+public:
+    using Ch = char;
+    explicit gzip_source(std::istream& in, size_t chunk_size = 64 * 1024) :
+        _in(in),
+        _chunk(chunk_size),
+        _in_buf(new char[chunk_size]),
+        _out_buf(new char[chunk_size]),
+        _cur(_out_buf.get()),
+        _end(_out_buf.get())
+    {
+        // 15 + 32: maximal window, detect gzip or zlib header automatically
+        if (inflateInit2(&_z, 15 + 32) != Z_OK)
+            throw std::runtime_error("gzip: inflateInit failed");
+        // The destructor does not run if the constructor throws
+        try
+        {
+            fill();
+        }
+        catch (...)
+        {
+            inflateEnd(&_z);
+            throw;
+        }
+    }
+    gzip_source(const gzip_source&) = delete;
+    gzip_source& operator=(const gzip_source&) = delete;
+    ~gzip_source() { inflateEnd(&_z); }
+
+    Ch Peek() const { return _cur == _end ? '\0' : *_cur; }
+    Ch Take()
+    {
+        if (_cur == _end)
+            return '\0';
+        const Ch c = *_cur++;
+        if (_cur == _end)
+            fill();
+        return c;
+    }
+    size_t Tell() const { return _base + (size_t)(_cur - _out_buf.get()); }
+
+    Ch* PutBegin() { assert(false); return nullptr; }
+    void Put(Ch) { assert(false); }
+    void Flush() { assert(false); }
+    size_t PutEnd(Ch*) { assert(false); return 0; }
+};
+
+// rapidjson output stream which deflates writer output to std::ostream chunk by chunk
+class gzip_sink
+{
+    std::ostream& _out;
+    z_stream _z{};
+    size_t _chunk;
+    std::unique_ptr<char[]> _in_buf;
+    std::unique_ptr<char[]> _out_buf;
+    size_t _size = 0;
+    bool _finished = false;
+
+    void compress(int flush)
+    {
+        _z.next_in = reinterpret_cast<Bytef*>(_in_buf.get());
+        _z.avail_in = (uInt)_size;
+        do
+        {
+            _z.next_out = reinterpret_cast<Bytef*>(_out_buf.get());
+            _z.avail_out = (uInt)_chunk;
+            if (deflate(&_z, flush) == Z_STREAM_ERROR)
+                throw std::runtime_error("gzip: deflate failed");
+            _out.write(_out_buf.get(), (std::streamsize)(_chunk - _z.avail_out));
+        } while (_z.avail_out == 0);
+        _size = 0;
+    }
+public:
+    using Ch = char;
+    explicit gzip_sink(std::ostream& out, int level = Z_DEFAULT_COMPRESSION, size_t chunk_size = 64 * 1024) :
+        _out(out),
+        _chunk(chunk_size),
+        _in_buf(new char[chunk_size]),
+        _out_buf(new char[chunk_size])
+    {
+        // 15 + 16: maximal window, write gzip header and trailer
+        if (deflateInit2(&_z, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("gzip: deflateInit failed");
+    }
+    gzip_sink(const gzip_sink&) = delete;
+    gzip_sink& operator=(const gzip_sink&) = delete;
+    ~gzip_sink() { deflateEnd(&_z); }
+
+    void Put(Ch c)
+    {
+        if (_size == _chunk)
+            compress(Z_NO_FLUSH);
+        _in_buf[_size++] = c;
+    }
+    // Called by the writer after the root value; the gzip trailer is written by finish()
+    void Flush() {}
+    void finish()
+    {
+        if (_finished)
+            return;
+        compress(Z_FINISH);
+        _finished = true;
+        _out.flush();
+    }
+};
+
+template<class T>
+void load_gzip(std::istream& str, T& result)
+{
+    gzip_source source(str);
+    load_stream(source, result);
+}
+template<class T>
+T load_gzip(std::istream& str)
+{
+    T result;
+    load_gzip(str, result);
+    return result;
+}
+template<class T>
+void dump_gzip(std::ostream& str, const T& value, int level = Z_DEFAULT_COMPRESSION)
+{
+    gzip_sink sink(str, level);
+    dump_stream(sink, value);
+    sink.finish();
+}
+#endif
+
+#if defined(JSON_DTO_HAS_ZSTD)
+// rapidjson input stream which decompresses zstd frames from std::istream chunk by chunk
+class zstd_source
+{
+    std::istream& _in;
+    std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> _ctx;
+    size_t _in_chunk = ZSTD_DStreamInSize();
+    size_t _out_chunk = ZSTD_DStreamOutSize();
+    std::unique_ptr<char[]> _in_buf;
+    std::unique_ptr<char[]> _out_buf;
+    ZSTD_inBuffer _input{ nullptr, 0, 0 };
+    const char* _cur;
+    const char* _end;
+    size_t _base = 0;
+    bool _done = false;
+    bool _frame_end = false;
+    bool _out_full = false;
+
+    void fill()
+    {
+        _base += (size_t)(_end - _out_buf.get());
+        _cur = _end = _out_buf.get();
+        while (_cur == _end && !_done)
+        {
+            if (_input.pos == _input.size && !_out_full)
+            {
+                _in.read(_in_buf.get(), (std::streamsize)_in_chunk);
+                _input = { _in_buf.get(), (size_t)_in.gcount(), 0 };
+                if (_input.size == 0)
+                {
+                    _done = true;
+                    if (!_frame_end)
+                        throw parse_exception("Truncated zstd stream");
+                    break;
+                }
+            }
+            ZSTD_outBuffer output{ _out_buf.get(), _out_chunk, 0 };
+            const size_t in_pos = _input.pos;
+            const size_t rc = ZSTD_decompressStream(_ctx.get(), &output, &_input);
+            if (ZSTD_isError(rc))
+                throw parse_exception(std::string("zstd: ") + ZSTD_getErrorName(rc));
+            // As for gzip: the end of a frame holds until data of a next frame arrives
+            if (rc == 0)
+                _frame_end = true;
+            else if (_input.pos != in_pos || output.pos != 0)
+                _frame_end = false;
+            _out_full = output.pos == output.size;
+            _end = _out_buf.get() + output.pos;
+        }
+    }
+public:
+    using Ch = char;
+    explicit zstd_source(std::istream& in) :
+        _in(in),
+        _ctx(ZSTD_createDCtx(), &ZSTD_freeDCtx),
+        _in_buf(new char[_in_chunk]),
+        _out_buf(new char[_out_chunk]),
+        _cur(_out_buf.get()),
+        _end(_out_buf.get())
+    {
+        if (!_ctx)
+            throw std::runtime_error("zstd: cannot create decompression context");
+        fill();
+    }
+    zstd_source(const zstd_source&) = delete;
+    zstd_source& operator=(const zstd_source&) = delete;
+
+    Ch Peek() const { return _cur == _end ? '\0' : *_cur; }
+    Ch Take()
+    {
+        if (_cur == _end)
+            return '\0';
+        const Ch c = *_cur++;
+        if (_cur == _end)
+            fill();
+        return c;
+    }
+    size_t Tell() const { return _base + (size_t)(_cur - _out_buf.get()); }
+
+    Ch* PutBegin() { assert(false); return nullptr; }
+    void Put(Ch) { assert(false); }
+    void Flush() { assert(false); }
+    size_t PutEnd(Ch*) { assert(false); return 0; }
+};
+
+// rapidjson output stream which compresses writer output to std::ostream chunk by chunk
+class zstd_sink
+{
+    std::ostream& _out;
+    std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> _ctx;
+    size_t _in_chunk = ZSTD_CStreamInSize();
+    size_t _out_chunk = ZSTD_CStreamOutSize();
+    std::unique_ptr<char[]> _in_buf;
+    std::unique_ptr<char[]> _out_buf;
+    size_t _size = 0;
+    bool _finished = false;
+
+    void compress(ZSTD_EndDirective mode)
+    {
+        ZSTD_inBuffer input{ _in_buf.get(), _size, 0 };
+        for (;;)
+        {
+            ZSTD_outBuffer output{ _out_buf.get(), _out_chunk, 0 };
+            const size_t remaining = ZSTD_compressStream2(_ctx.get(), &output, &input, mode);
+            if (ZSTD_isError(remaining))
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(remaining));
+            _out.write(_out_buf.get(), (std::streamsize)output.pos);
+            if (mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size)
+                break;
+        }
+        _size = 0;
+    }
+public:
+    using Ch = char;
+    explicit zstd_sink(std::ostream& out, int level = ZSTD_CLEVEL_DEFAULT) :
+        _out(out),
+        _ctx(ZSTD_createCCtx(), &ZSTD_freeCCtx),
+        _in_buf(new char[_in_chunk]),
+        _out_buf(new char[_out_chunk])
+    {
+        if (!_ctx)
+            throw std::runtime_error("zstd: cannot create compression context");
+        if (const size_t rc = ZSTD_CCtx_setParameter(_ctx.get(), ZSTD_c_compressionLevel, level); ZSTD_isError(rc))
+            throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(rc));
+    }
+    zstd_sink(const zstd_sink&) = delete;
+    zstd_sink& operator=(const zstd_sink&) = delete;
+
+    void Put(Ch c)
+    {
+        if (_size == _in_chunk)
+            compress(ZSTD_e_continue);
+        _in_buf[_size++] = c;
+    }
+    // Called by the writer after the root value; the frame is closed by finish()
+    void Flush() {}
+    void finish()
+    {
+        if (_finished)
+            return;
+        compress(ZSTD_e_end);
+        _finished = true;
+        _out.flush();
+    }
+};
+
+template<class T>
+void load_zstd(std::istream& str, T& result)
+{
+    zstd_source source(str);
+    load_stream(source, result);
+}
+template<class T>
+T load_zstd(std::istream& str)
+{
+    T result;
+    load_zstd(str, result);
+    return result;
+}
+template<class T>
+void dump_zstd(std::ostream& str, const T& value, int level = ZSTD_CLEVEL_DEFAULT)
+{
+    zstd_sink sink(str, level);
+    dump_stream(sink, value);
+    sink.finish();
+}
+#endif
+}
@@ -0,0 +1,918 @@
+#pragma once
+
+#include "json_dto.h"
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<liburing.h>) && !defined(JSON_DTO_NO_IO_URING)
+#include <liburing.h>
+#define JSON_DTO_HAS_IO_URING 1
+#endif
+
+namespace json_dto
+{
+struct load_files_options
+{
+    // Maximal number of file reads in flight; without io_uring, also at most one per hardware thread
+    size_t queue_depth = 64;
+    // Maximal total size of file contents read but not parsed yet; a single larger file is still loaded alone
+    size_t max_inflight_bytes = 64u << 20;
+    // Number of parsing threads, 0 means std::thread::hardware_concurrency()
+    unsigned workers = 0;
+};
+
+namespace detail
+{
+[[noreturn]] JSON_DTO_COLD inline void throw_errno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+class fd_holder
+{
+    int _fd;
+public:
+    explicit fd_holder(int fd) : _fd(fd) {}
+    fd_holder(const fd_holder&) = delete;
+    fd_holder& operator=(const fd_holder&) = delete;
+    ~fd_holder() { if (_fd >= 0) ::close(_fd); }
+    int get() const { return _fd; }
+};
+
+class byte_budget
+{
+    std::mutex _m;
+    std::condition_variable _cv;
+    size_t _limit;
+    size_t _used = 0;
+public:
+    explicit byte_budget(size_t limit) : _limit(limit) {}
+    bool try_acquire(size_t n)
+    {
+        std::lock_guard lock(_m);
+        if (_used != 0 && _used + n > _limit)
+            return false;
+        _used += n;
+        return true;
+    }
+    void acquire(size_t n)
+    {
+        std::unique_lock lock(_m);
+        _cv.wait(lock, [&] { return _used == 0 || _used + n <= _limit; });
+        _used += n;
+    }
+    void release(size_t n)
+    {
+        {
+            std::lock_guard lock(_m);
+            _used -= n;
+        }
+        _cv.notify_all();
+    }
+};
+
+// Null-terminated contents of one file, suitable for in-situ parsing
+struct file_buffer
+{
+    size_t index = 0;
+    size_t size = 0;
+    std::unique_ptr<char[]> data;
+    std::exception_ptr error;
+};
+
+template<class Item>
+class work_queue
+{
+    std::mutex _m;
+    std::condition_variable _cv;
+    std::deque<Item> _items;
+    bool _closed = false;
+public:
+    void push(Item item)
+    {
+        {
+            std::lock_guard lock(_m);
+            _items.push_back(std::move(item));
+        }
+        _cv.notify_one();
+    }
+    void close()
+    {
+        {
+            std::lock_guard lock(_m);
+            _closed = true;
+        }
+        _cv.notify_all();
+    }
+    std::optional<Item> pop()
+    {
+        std::unique_lock lock(_m);
+        _cv.wait(lock, [&] { return _closed || !_items.empty(); });
+        if (_items.empty())
+            return std::nullopt;
+        Item item = std::move(_items.front());
+        _items.pop_front();
+        return item;
+    }
+};
+
+inline int open_for_read(const std::filesystem::path& path, size_t& size)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("Cannot open " + path.string());
+    struct stat st{};
+    if (::fstat(fd, &st) != 0)
+    {
+        const int err = errno;
+        ::close(fd);
+        errno = err;
+        throw_errno("Cannot stat " + path.string());
+    }
+    size = (size_t)st.st_size;
+    return fd;
+}
+
+inline void pread_all(int fd, char* data, size_t size, const std::filesystem::path& path)
+{
+    for (size_t done = 0; done < size;)
+    {
+        const ssize_t n = ::pread(fd, data + done, size - done, (off_t)done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw_errno("Cannot read " + path.string());
+        if (n == 0)
+            throw parse_exception("Unexpected end of file: " + path.string());
+        done += (size_t)n;
+    }
+}
+
+template<class T>
+void parse_insitu(char* data, T& result, const std::filesystem::path& path)
+{
+    rapidjson::Document doc;
+    if (rapidjson::ParseResult pr = doc.ParseInsitu(data); pr.IsError())
+        throw parse_exception(pr);
+    convert_root(doc, result, [&]
+    {
+        // The in-situ parse has unescaped strings over the buffer, so the text for the error location is read again
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    });
+}
+
+// Reads files with a pool of threads doing blocking pread, no more threads than the hardware runs
+inline void read_files_pread(std::span<const std::filesystem::path> paths, const load_files_options& options,
+    byte_budget& budget, work_queue<file_buffer>& queue)
+{
+    std::atomic<size_t> next{ 0 };
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const size_t threads = std::max<size_t>(1, std::min({ options.queue_depth, paths.size(), cores }));
+    std::vector<std::jthread> readers;
+    readers.reserve(threads);
+    for (size_t t = 0; t < threads; ++t)
+        readers.emplace_back([&]
+        {
+            for (size_t i = next++; i < paths.size(); i = next++)
+            {
+                file_buffer buffer;
+                buffer.index = i;
+                try
+                {
+                    size_t size;
+                    fd_holder fd(open_for_read(paths[i], size));
+                    budget.acquire(size);
+                    buffer.size = size;
+                    buffer.data.reset(new char[size + 1]);
+                    buffer.data[size] = '\0';
+                    pread_all(fd.get(), buffer.data.get(), size, paths[i]);
+                }
+                catch (...)
+                {
+                    buffer.error = std::current_exception();
+                }
+                queue.push(std::move(buffer));
+            }
+        });
+}
+
+#if defined(JSON_DTO_HAS_IO_URING)
+// Reads files from the calling thread with up to queue_depth io_uring reads in flight.
+// Returns false if io_uring is not available at run time.
+inline bool read_files_uring(std::span<const std::filesystem::path> paths, const load_files_options& options,
+    byte_budget& budget, work_queue<file_buffer>& queue)
+{
+    const unsigned depth = (unsigned)std::clamp<size_t>(options.queue_depth, 1, 4096);
+    struct pending_read
+    {
+        file_buffer buffer;
+        int fd = -1;
+        size_t done = 0;
+        ~pending_read() { if (fd >= 0) ::close(fd); }
+    };
+    std::vector<pending_read> slots(depth);
+    std::vector<pending_read*> free_slots;
+    for (auto& slot : slots)
+        free_slots.push_back(&slot);
+    io_uring ring;
+    if (io_uring_queue_init(depth, &ring, 0) < 0)
+        return false;
+    // Declared after the slots, so the ring is torn down before their buffers and files
+    const struct ring_guard
+    {
+        io_uring& ring;
+        ~ring_guard() { io_uring_queue_exit(&ring); }
+    } guard{ ring };
+    // Slot of the next file, which is open but did not fit into the budget yet
+    pending_read* opened = nullptr;
+
+    const auto finish = [&](pending_read& slot)
+    {
+        if (slot.fd >= 0)
+            ::close(slot.fd);
+        slot.fd = -1;
+        queue.push(std::move(slot.buffer));
+        free_slots.push_back(&slot);
+    };
+    const auto submit = [&](pending_read& slot)
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, slot.fd, slot.buffer.data.get() + slot.done,
+            (unsigned)std::min<size_t>(slot.buffer.size - slot.done, 1u << 30), (uint64_t)slot.done);
+        io_uring_sqe_set_data(sqe, &slot);
+    };
+
+    size_t next = 0;
+    size_t in_flight = 0;
+    while (next < paths.size() || in_flight != 0)
+    {
+        while (next < paths.size() && (opened || !free_slots.empty()))
+        {
+            pending_read* p_slot = std::exchange(opened, nullptr);
+            if (!p_slot)
+            {
+                p_slot = free_slots.back();
+                free_slots.pop_back();
+            }
+            pending_read& slot = *p_slot;
+            if (slot.fd < 0)
+            {
+                slot.buffer = file_buffer{};
+                slot.buffer.index = next;
+                slot.done = 0;
+                try
+                {
+                    slot.fd = open_for_read(paths[next], slot.buffer.size);
+                }
+                catch (...)
+                {
+                    slot.buffer.error = std::current_exception();
+                    ++next;
+                    finish(slot);
+                    continue;
+                }
+            }
+            const size_t size = slot.buffer.size;
+            // With reads in flight the budget must not block: their completions are reaped by this thread
+            if (in_flight == 0)
+                budget.acquire(size);
+            else if (!budget.try_acquire(size))
+            {
+                opened = &slot;
+                break;
+            }
+            ++next;
+            slot.buffer.data.reset(new char[size + 1]);
+            slot.buffer.data[size] = '\0';
+            if (size == 0)
+            {
+                finish(slot);
+                continue;
+            }
+            submit(slot);
+            ++in_flight;
+        }
+        if (in_flight == 0)
+            continue;
+        io_uring_submit(&ring);
+        io_uring_cqe* cqe;
+        if (const int rc = io_uring_wait_cqe(&ring, &cqe); rc < 0)
+        {
+            if (rc == -EINTR)
+                continue;
+            errno = -rc;
+            throw_errno("io_uring_wait_cqe failed");
+        }
+        auto& slot = *static_cast<pending_read*>(io_uring_cqe_get_data(cqe));
+        const int res = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        if (res == -EINTR || res == -EAGAIN)
+        {
+            submit(slot);
+            continue;
+        }
+        if (res <= 0)
+        {
+            const auto& path = paths[slot.buffer.index];
+            try
+            {
+                if (res == 0)
+                    throw parse_exception("Unexpected end of file: " + path.string());
+                errno = -res;
+                throw_errno("Cannot read " + path.string());
+            }
+            catch (...)
+            {
+                slot.buffer.error = std::current_exception();
+            }
+            --in_flight;
+            finish(slot);
+            continue;
+        }
+        slot.done += (size_t)res;
+        if (slot.done < slot.buffer.size)
+        {
+            submit(slot);
+            continue;
+        }
+        --in_flight;
+        finish(slot);
+    }
+    return true;
+}
+#endif
+}
+
+// Loads many small JSON files concurrently. Files are read with io_uring when it is available
+// (a pool of pread threads otherwise) and parsed on options.workers threads.
+// callback(index, T&&) is called from the worker threads, possibly concurrently, for every file
+// which was loaded; the first failure is rethrown after all other files are processed.
+template<class T, class Callback>
+void load_files(std::span<const std::filesystem::path> paths, Callback&& callback, const load_files_options& options = {})
+{
+    detail::byte_budget budget(options.max_inflight_bytes);
+    detail::work_queue<detail::file_buffer> queue;
+    std::mutex error_mutex;
+    std::exception_ptr first_error;
+    size_t first_error_index = paths.size();
+    const auto set_error = [&](size_t index, std::exception_ptr error)
+    {
+        std::lock_guard lock(error_mutex);
+        if (index < first_error_index)
+        {
+            first_error_index = index;
+            first_error = std::move(error);
+        }
+    };
+
+    const unsigned workers = options.workers ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+    {
+        std::vector<std::jthread> parsers;
+        parsers.reserve(workers);
+        for (unsigned w = 0; w < workers; ++w)
+            parsers.emplace_back([&]
+            {
+                while (auto buffer = queue.pop())
+                {
+                    T result;
+                    bool parsed = false;
+                    try
+                    {
+                        if (buffer->error)
+                            std::rethrow_exception(buffer->error);
+                        detail::parse_insitu(buffer->data.get(), result, paths[buffer->index]);
+                        parsed = true;
+                    }
+                    catch (...)
+                    {
+                        set_error(buffer->index, std::current_exception());
+                    }
+                    buffer->data.reset();
+                    budget.release(buffer->size);
+                    if (!parsed)
+                        continue;
+                    try
+                    {
+                        callback(buffer->index, std::move(result));
+                    }
+                    catch (...)
+                    {
+                        set_error(buffer->index, std::current_exception());
+                    }
+                }
+            });
+
+        try
+        {
+#if defined(JSON_DTO_HAS_IO_URING)
+            if (!detail::read_files_uring(paths, options, budget, queue))
+#endif
+                detail::read_files_pread(paths, options, budget, queue);
+        }
+        catch (...)
+        {
+            set_error(0, std::current_exception());
+        }
+        queue.close();
+    }
+    if (first_error)
+        std::rethrow_exception(first_error);
+}
+
+// Read-only memory mapping of a whole file
+class mapped_file
+{
+    const char* _data = nullptr;
+    size_t _size = 0;
+public:
+    explicit mapped_file(const std::filesystem::path& path, int advice = MADV_NORMAL)
+    {
+        size_t size;
+        detail::fd_holder fd(detail::open_for_read(path, size));
+        if (size == 0)
+            return;
+        void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+        if (p == MAP_FAILED)
+            detail::throw_errno("Cannot map " + path.string());
+        ::madvise(p, size, advice);
+        _data = static_cast<const char*>(p);
+        _size = size;
+    }
+    mapped_file(mapped_file&& other) noexcept :
+        _data(std::exchange(other._data, nullptr)),
+        _size(std::exchange(other._size, 0))
+    {}
+    mapped_file& operator=(mapped_file&& other) noexcept
+    {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        return *this;
+    }
+    ~mapped_file()
+    {
+        if (_data)
+            ::munmap(const_cast<char*>(_data), _size);
+    }
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    std::string_view view() const { return { _data, _size }; }
+};
+
+enum class record_format
+{
+    // A single top-level JSON array, records are its elements
+    array,
+    // Newline-delimited JSON, one value per line
+    ndjson
+};
+
+namespace detail
+{
+// Calls f(begin, end) for every value of a sequence starting at pos, separated by whitespace or, if commas is set, by commas
+template<class F>
+void for_each_value(std::string_view s, size_t pos, bool commas, F&& f)
+{
+    pos = skip_ws(s, pos);
+    while (pos < s.size())
+    {
+        const size_t end = skip_value(s, pos);
+        f(pos, end);
+        pos = skip_ws(s, end);
+        if (commas && pos < s.size() && s[pos] == ',')
+            pos = skip_ws(s, pos + 1);
+        else if (pos == end && pos < s.size())
+            throw parse_exception("Missing separator at offset " + std::to_string(pos));
+    }
+}
+}
+
+// Calls f(begin, end) for every record of a JSON array or NDJSON text
+template<class F>
+void for_each_record(std::string_view s, record_format format, F&& f)
+{
+    size_t pos = detail::skip_ws(s, 0);
+    if (format == record_format::ndjson)
+        return detail::for_each_value(s, pos, false, f);
+    if (pos >= s.size() || s[pos] != '[')
+        throw parse_exception("JSON array expected at offset " + std::to_string(pos));
+    pos = detail::skip_ws(s, pos + 1);
+    if (pos < s.size() && s[pos] == ']')
+        return;
+    for (;;)
+    {
+        const size_t end = detail::skip_value(s, pos);
+        f(pos, end);
+        pos = detail::skip_ws(s, end);
+        if (pos < s.size() && s[pos] == ',')
+            pos = detail::skip_ws(s, pos + 1);
+        else if (pos < s.size() && s[pos] == ']')
+            return;
+        else
+            throw parse_exception("Malformed array at offset " + std::to_string(pos));
+    }
+}
+
+struct byte_range
+{
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// Splits a JSON array or NDJSON file into at most n ranges of whole records of about equal size.
+// NDJSON is split at the first newline after each cut point, an array needs one structural scan.
+inline std::vector<byte_range> partition(const std::filesystem::path& path, size_t n, record_format format)
+{
+    if (n == 0)
+        throw std::invalid_argument("Number of partitions must be positive");
+    const mapped_file data(path, MADV_SEQUENTIAL);
+    const auto text = data.view();
+    std::vector<byte_range> ranges;
+    ranges.reserve(n);
+    if (format == record_format::array)
+    {
+        size_t begin = std::string_view::npos;
+        size_t last = 0;
+        for_each_record(text, record_format::array, [&](size_t b, size_t e)
+        {
+            if (begin == std::string_view::npos)
+                begin = b;
+            last = e;
+            if (ranges.size() + 1 < n && e >= (ranges.size() + 1) * text.size() / n)
+            {
+                ranges.push_back({ begin, e });
+                begin = std::string_view::npos;
+            }
+        });
+        if (begin != std::string_view::npos)
+            ranges.push_back({ begin, last });
+        return ranges;
+    }
+    size_t begin = detail::skip_ws(text, 0);
+    for (size_t k = 1; k < n && begin < text.size(); ++k)
+    {
+        const size_t newline = text.find('\n', std::max(begin, k * text.size() / n));
+        const size_t end = newline == std::string_view::npos ? text.size() : newline + 1;
+        ranges.push_back({ begin, end });
+        begin = end;
+    }
+    if (begin < text.size())
+        ranges.push_back({ begin, text.size() });
+    return ranges;
+}
+
+// Loads every record of a range returned by partition() and calls callback(T&&) for it.
+// A range holds top-level values separated by commas (array elements) or newlines (NDJSON).
+template<class T, class Callback>
+void load_range(const std::filesystem::path& path, const byte_range& range, Callback&& callback)
+{
+    const mapped_file data(path, MADV_SEQUENTIAL);
+    const auto text = data.view().substr(range.begin, range.end - range.begin);
+    detail::for_each_value(text, 0, true, [&](size_t b, size_t e)
+    {
+        callback(loads<T>(text.substr(b, e - b)));
+    });
+}
+
+namespace detail
+{
+struct index_header
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t data_size;
+    int64_t data_mtime;
+    uint64_t records;
+    uint64_t keys;
+};
+struct index_record
+{
+    uint64_t begin;
+    uint64_t end;
+};
+struct index_key
+{
+    uint64_t key_begin;
+    uint64_t key_size;
+    uint64_t record;
+};
+constexpr char index_magic[4] = { 'J', 'D', 'I', 'X' };
+constexpr uint32_t index_version = 3;
+
+// Modification time of the data file, which together with its size tells whether an index is stale
+inline int64_t data_mtime(const std::filesystem::path& path)
+{
+    return (int64_t)std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+// Strings are keyed by their unescaped contents, other values by their text
+inline void append_key(std::string& blob, std::string_view value)
+{
+    if (value.size() >= 2 && value.front() == '"')
+        append_unescaped(blob, value.substr(1, value.size() - 2));
+    else
+        blob += value;
+}
+}
+
+// Writes a sidecar index of record offsets of a JSON array or NDJSON file.
+// With non-empty key_field the records are also indexed by the value of that top-level member.
+inline void build_index(const std::filesystem::path& data_path, const std::filesystem::path& index_path, record_format format,
+    std::string_view key_field = {})
+{
+    const int64_t mtime = detail::data_mtime(data_path);
+    const mapped_file data(data_path, MADV_SEQUENTIAL);
+    const auto text = data.view();
+    std::vector<detail::index_record> records;
+    std::vector<detail::index_key> keys;
+    std::string key_blob;
+    for_each_record(text, format, [&](size_t begin, size_t end)
+    {
+        if (!key_field.empty())
+        {
+            const auto prefix = text.substr(0, end);
+            if (auto member = detail::find_member(prefix, begin, key_field))
+            {
+                const size_t key_begin = key_blob.size();
+                detail::append_key(key_blob, prefix.substr(*member, detail::skip_value(prefix, *member) - *member));
+                keys.push_back({ key_begin, key_blob.size() - key_begin, records.size() });
+            }
+        }
+        records.push_back({ begin, end });
+    });
+    std::stable_sort(keys.begin(), keys.end(), [&](const detail::index_key& x, const detail::index_key& y)
+    {
+        return std::string_view(key_blob).substr(x.key_begin, x.key_size) < std::string_view(key_blob).substr(y.key_begin, y.key_size);
+    });
+
+    detail::index_header header{};
+    std::copy(std::begin(detail::index_magic), std::end(detail::index_magic), header.magic);
+    header.version = detail::index_version;
+    header.data_size = text.size();
+    header.data_mtime = mtime;
+    header.records = records.size();
+    header.keys = keys.size();
+    std::ofstream out(index_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(records.data()), (std::streamsize)(records.size() * sizeof(detail::index_record)));
+    out.write(reinterpret_cast<const char*>(keys.data()), (std::streamsize)(keys.size() * sizeof(detail::index_key)));
+    out.write(key_blob.data(), (std::streamsize)key_blob.size());
+    if (!out.flush())
+        throw std::runtime_error("Cannot write " + index_path.string());
+}
+
+// Random access to the records of a JSON array or NDJSON file through its sidecar index
+class record_index
+{
+    mapped_file _data;
+    mapped_file _index;
+    const detail::index_record* _records = nullptr;
+    const detail::index_key* _keys = nullptr;
+    const char* _key_blob = nullptr;
+    size_t _size = 0;
+    size_t _key_count = 0;
+
+    size_t _key_blob_size = 0;
+
+    std::string_view key(const detail::index_key& k) const
+    {
+        if (k.key_size > _key_blob_size || k.key_begin > _key_blob_size - k.key_size)
+            throw parse_exception("Corrupt index: key out of range");
+        return { _key_blob + k.key_begin, (size_t)k.key_size };
+    }
+public:
+    record_index(const std::filesystem::path& data_path, const std::filesystem::path& index_path) :
+        _data(data_path, MADV_RANDOM),
+        _index(index_path)
+    {
+        const int64_t mtime = detail::data_mtime(data_path);
+        const auto invalid = [&] { return parse_exception("Invalid or stale index: " + index_path.string()); };
+        if (_index.size() < sizeof(detail::index_header))
+            throw invalid();
+        const auto& header = *reinterpret_cast<const detail::index_header*>(_index.data());
+        if (!std::equal(std::begin(detail::index_magic), std::end(detail::index_magic), header.magic) ||
+            header.version != detail::index_version || header.data_size != _data.size() || header.data_mtime != mtime)
+            throw invalid();
+        // Sizes come from the file, so they are checked against what is there before any multiplication
+        size_t available = _index.size() - sizeof(header);
+        if (header.records > available / sizeof(detail::index_record))
+            throw invalid();
+        available -= (size_t)header.records * sizeof(detail::index_record);
+        if (header.keys > available / sizeof(detail::index_key))
+            throw invalid();
+        available -= (size_t)header.keys * sizeof(detail::index_key);
+        _size = (size_t)header.records;
+        _key_count = (size_t)header.keys;
+        _records = reinterpret_cast<const detail::index_record*>(_index.data() + sizeof(header));
+        _keys = reinterpret_cast<const detail::index_key*>(_records + _size);
+        _key_blob = _index.data() + (_index.size() - available);
+        _key_blob_size = available;
+    }
+
+    size_t size() const { return _size; }
+    std::string_view record(size_t n) const
+    {
+        if (n >= _size)
+            throw std::out_of_range("Record index out of range");
+        const auto& r = _records[n];
+        if (r.begin > r.end || r.end > _data.size())
+            throw parse_exception("Corrupt index: record out of range");
+        return _data.view().substr((size_t)r.begin, (size_t)(r.end - r.begin));
+    }
+    // Number of the first record with the given key
+    std::optional<size_t> find(std::string_view k) const
+    {
+        const auto it = std::lower_bound(_keys, _keys + _key_count, k,
+            [&](const detail::index_key& x, std::string_view y) { return key(x) < y; });
+        if (it == _keys + _key_count || key(*it) != k)
+            return std::nullopt;
+        return (size_t)it->record;
+    }
+    template<class T>
+    T load(size_t n) const
+    {
+        return loads<T>(record(n));
+    }
+    template<class T>
+    std::optional<T> load_by_key(std::string_view k) const
+    {
+        if (auto n = find(k))
+            return load<T>(*n);
+        return std::nullopt;
+    }
+};
+
+namespace detail
+{
+inline void pwrite_all(int fd, const char* data, size_t size, size_t offset, const std::filesystem::path& path)
+{
+    for (size_t done = 0; done < size;)
+    {
+        const ssize_t n = ::pwrite(fd, data + done, size - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw_errno("Cannot write " + path.string());
+        done += (size_t)n;
+    }
+}
+}
+
+// Callback for blob_sink which writes the chunks to a file descriptor
+inline blob_sink::callback write_to_fd(int fd)
+{
+    return [fd](std::span<const char> chunk)
+    {
+        for (size_t done = 0; done < chunk.size();)
+        {
+            const ssize_t n = ::write(fd, chunk.data() + done, chunk.size() - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                detail::throw_errno("Cannot write blob to file descriptor " + std::to_string(fd));
+            done += (size_t)n;
+        }
+    };
+}
+
+// Appends records to a file holding a single JSON array without rewriting it.
+// A batch ",r1,r2]" is first written after the closing bracket, then the old bracket is replaced by a space,
+// so the file always starts with a valid array; a torn batch after it is truncated when the file is opened again.
+template<class T>
+class array_appender
+{
+    std::filesystem::path _path;
+    int _fd = -1;
+    size_t _close_pos = 0;
+    bool _empty = true;
+    bool _durable;
+    size_t _batch_bytes;
+    std::string _pending;
+
+    void sync()
+    {
+        if (_durable && ::fdatasync(_fd) != 0)
+            detail::throw_errno("Cannot sync " + _path.string());
+    }
+public:
+    explicit array_appender(std::filesystem::path path, size_t batch_bytes = 64 * 1024, bool durable = true) :
+        _path(std::move(path)),
+        _durable(durable),
+        _batch_bytes(batch_bytes)
+    {
+        _fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (_fd < 0)
+            detail::throw_errno("Cannot open " + _path.string());
+        try
+        {
+            size_t size, tail;
+            {
+                const mapped_file data(_path, MADV_SEQUENTIAL);
+                const auto text = data.view();
+                size = text.size();
+                const size_t begin = detail::skip_ws(text, 0);
+                if (begin == size)
+                {
+                    detail::pwrite_all(_fd, "[]", 2, 0, _path);
+                    _close_pos = 1;
+                    tail = size = 2;
+                }
+                else
+                {
+                    if (text[begin] != '[')
+                        throw parse_exception("Not a JSON array: " + _path.string());
+                    const size_t end = detail::skip_value(text, begin);
+                    _close_pos = end - 1;
+                    _empty = detail::skip_ws(text, begin + 1) == _close_pos;
+                    tail = detail::skip_ws(text, end) == size ? size : end;
+                }
+            }
+            if (tail != size && ::ftruncate(_fd, (off_t)tail) != 0)
+                detail::throw_errno("Cannot truncate " + _path.string());
+            sync();
+        }
+        catch (...)
+        {
+            ::close(_fd);
+            throw;
+        }
+    }
+    array_appender(const array_appender&) = delete;
+    array_appender& operator=(const array_appender&) = delete;
+    // A failure of the final flush is discarded here, so the records still pending are lost silently;
+    // call close() to get the error
+    ~array_appender()
+    {
+        if (_fd < 0)
+            return;
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+        ::close(_fd);
+    }
+
+    void append(const T& value)
+    {
+        if (!_empty || !_pending.empty())
+            _pending += ',';
+        _pending += dumps(value);
+        if (_pending.size() >= _batch_bytes)
+            flush();
+    }
+    // On failure the pending records are kept and the next flush writes the same batch again at the same place,
+    // which is safe whichever of the two writes reached the file
+    void flush()
+    {
+        if (_pending.empty())
+            return;
+        _pending += ']';
+        try
+        {
+            detail::pwrite_all(_fd, _pending.data(), _pending.size(), _close_pos + 1, _path);
+            sync();
+            detail::pwrite_all(_fd, " ", 1, _close_pos, _path);
+            sync();
+        }
+        catch (...)
+        {
+            _pending.pop_back();
+            throw;
+        }
+        _close_pos += _pending.size();
+        _empty = false;
+        _pending.clear();
+    }
+    // Flushes the pending records and closes the file. If the flush fails the file stays open,
+    // so it can be retried or the appender destroyed.
+    void close()
+    {
+        if (_fd < 0)
+            return;
+        flush();
+        if (::close(std::exchange(_fd, -1)) != 0)
+            detail::throw_errno("Cannot close " + _path.string());
+    }
+};
+}
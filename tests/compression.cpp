@@ -0,0 +1,120 @@
+// gzip and zstd sources and sinks: round trips at sizes around the chunk boundaries,
+// empty payloads, concatenated members or frames, and truncated input
+#include <json_dto_compression.h>
+
+#include <cstdio>
+#include <sstream>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+template<class F>
+bool throws_parse_exception(F&& f)
+{
+    try
+    {
+        f();
+    }
+    catch (const json_dto::parse_exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+// Deterministic, poorly compressible text, so the compressed size grows with the input
+std::string payload(size_t size)
+{
+    std::string text(size, ' ');
+    uint32_t x = 12345;
+    for (char& c : text)
+    {
+        x = x * 1103515245 + 12345;
+        c = (char)('a' + (x >> 16) % 26);
+    }
+    return text;
+}
+
+template<class Sink, class... Args>
+std::string compress(const std::string& text, Args... args)
+{
+    std::ostringstream out;
+    Sink sink(out, args...);
+    for (const char c : text)
+        sink.Put(c);
+    sink.Flush();
+    sink.finish();
+    return out.str();
+}
+
+template<class Source>
+std::string decompress(const std::string& data)
+{
+    std::istringstream in(data);
+    Source source(in);
+    std::string text;
+    while (source.Peek() != '\0')
+        text += source.Take();
+    if (source.Tell() != text.size())
+        throw std::logic_error("Tell does not count the taken characters");
+    return text;
+}
+
+template<class Source, class Sink>
+void check_codec(const char* name, size_t chunk)
+{
+    const size_t sizes[] = { 1, 1000, chunk - 1, chunk, chunk + 1, 2 * chunk, 2 * chunk + 1, 5 * chunk };
+    for (const size_t size : sizes)
+    {
+        const std::string text = payload(size);
+        const std::string what = std::string(name) + " round trips " + std::to_string(size) + " bytes";
+        bool ok = false;
+        try
+        {
+            ok = decompress<Source>(compress<Sink>(text)) == text;
+        }
+        catch (const std::exception& e)
+        {
+            std::fprintf(stderr, "%s: %s\n", what.c_str(), e.what());
+        }
+        check(ok, what.c_str());
+    }
+
+    check(decompress<Source>(compress<Sink>("")).empty(), (std::string(name) + " round trips an empty payload").c_str());
+    check(throws_parse_exception([] { decompress<Source>(""); }), (std::string(name) + " rejects empty input").c_str());
+
+    const std::string first = payload(chunk), second = payload(3 * chunk / 2);
+    check(decompress<Source>(compress<Sink>(first) + compress<Sink>(second)) == first + second,
+        (std::string(name) + " reads concatenated streams").c_str());
+    check(decompress<Source>(compress<Sink>("") + compress<Sink>(first)) == first,
+        (std::string(name) + " reads a stream after an empty one").c_str());
+
+    const std::string whole = compress<Sink>(payload(3 * chunk));
+    for (const size_t cut : { whole.size() - 1, whole.size() / 2, size_t{ 10 } })
+        check(throws_parse_exception([&] { decompress<Source>(whole.substr(0, cut)); }),
+            (std::string(name) + " rejects truncated input").c_str());
+    check(throws_parse_exception([&] { decompress<Source>(whole + whole.substr(0, 10)); }),
+        (std::string(name) + " rejects a truncated second stream").c_str());
+}
+}
+
+int main()
+{
+#if defined(JSON_DTO_HAS_ZLIB)
+    check_codec<json_dto::gzip_source, json_dto::gzip_sink>("gzip", 64 * 1024);
+#endif
+#if defined(JSON_DTO_HAS_ZSTD)
+    check_codec<json_dto::zstd_source, json_dto::zstd_sink>("zstd", ZSTD_DStreamOutSize());
+#endif
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// convert<To>(from) gives values independent of the source, as the JSON round trip it replaces did:
+// fields of the same type are copied only when the copy does not share pointed-to objects
+#include <json_dto.h>
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+struct inner
+{
+    std::shared_ptr<int> p;
+
+    void serialization(auto& io)
+    {
+        io("inner")("p", p);
+    }
+};
+
+struct node
+{
+    int n = 0;
+    std::vector<node> children;
+
+    void serialization(auto& io)
+    {
+        io("node")("n", n)("children", children);
+    }
+};
+
+struct plain
+{
+    int i = 0;
+    std::string s;
+    std::vector<std::optional<double>> v;
+    std::map<std::string, std::vector<int>> m;
+
+    void serialization(auto& io)
+    {
+        io("plain")("i", i)("s", s)("v", v)("m", m);
+    }
+};
+
+struct shared
+{
+    std::shared_ptr<int> p;
+    std::vector<std::shared_ptr<std::string>> v;
+    std::optional<inner> nested;
+    plain copied;
+
+    void serialization(auto& io)
+    {
+        io("shared")("p", p)("v", v)("nested", nested)("copied", copied);
+    }
+};
+}
+
+int main()
+{
+    check(json_dto::detail::copies_deep<plain>(), "plain fields copy deep");
+    check(!json_dto::detail::copies_deep<std::shared_ptr<int>>(), "shared_ptr is shared by a copy");
+    check(!json_dto::detail::copies_deep<int*>(), "a pointer is shared by a copy");
+    check(!json_dto::detail::copies_deep<std::vector<std::shared_ptr<int>>>(), "a container of shared_ptr is shared by a copy");
+    check(!json_dto::detail::copies_deep<inner>(), "a DTO with a shared_ptr is shared by a copy");
+    check(!json_dto::detail::copies_deep<node>(), "a DTO containing itself is not copied");
+
+    shared from;
+    from.p = std::make_shared<int>(1);
+    from.v.push_back(std::make_shared<std::string>("a"));
+    from.nested = inner{ std::make_shared<int>(2) };
+    from.copied = { 3, "b", { 4.5, std::nullopt }, { { "c", { 6 } } } };
+    const shared to = json_dto::convert<shared>(from);
+    check(to.p && to.p != from.p && *to.p == 1, "shared_ptr field gets its own object");
+    check(to.v.size() == 1 && to.v[0] != from.v[0] && *to.v[0] == "a", "shared_ptr items get their own objects");
+    check(to.nested && to.nested->p != from.nested->p && *to.nested->p == 2, "nested shared_ptr gets its own object");
+    *from.p = 10;
+    *from.v[0] = "z";
+    check(*to.p == 1 && *to.v[0] == "a", "changing the source leaves the target alone");
+    check(to.copied.i == 3 && to.copied.s == "b" && to.copied.v.size() == 2 && to.copied.m.at("c") == std::vector<int>{ 6 },
+        "plain fields are copied");
+
+    node tree{ 1, { { 2, {} }, { 3, { { 4, {} } } } } };
+    const node copy = json_dto::convert<node>(tree);
+    check(copy.children.size() == 2 && copy.children[1].children[0].n == 4, "a recursive DTO converts");
+    return failures == 0 ? 0 : 1;
+}
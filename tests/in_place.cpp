@@ -0,0 +1,120 @@
+// Loading optional, unique_ptr, shared_ptr, variant and map values constructs each item once, in its final place:
+// no copies or moves of the item and no allocations beyond the holder's own storage.
+#include <json_dto.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+
+namespace
+{
+std::atomic<size_t> allocations{ 0 };
+}
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+// Counts how it was made; loaded from an integer by its own adapter
+struct probe
+{
+    static inline int constructed = 0;
+    static inline int copied = 0;
+    static inline int moved = 0;
+    int x = 0;
+
+    probe() { ++constructed; }
+    probe(const probe& other) : x(other.x) { ++copied; }
+    probe(probe&& other) noexcept : x(other.x) { ++moved; }
+    probe& operator=(const probe& other) { x = other.x; ++copied; return *this; }
+    probe& operator=(probe&& other) noexcept { x = other.x; ++moved; return *this; }
+
+    static void reset() { constructed = copied = moved = 0; }
+};
+}
+
+template<>
+struct json_dto::adapter<probe>
+{
+    static bool get(value_c v, probe& value)
+    {
+        if (!v.IsInt())
+            return false;
+        value.x = v.GetInt();
+        return true;
+    }
+    static void set(allocator&, value_r v, const probe& value) { v.SetInt(value.x); }
+};
+
+namespace
+{
+// Parses json, then converts it with the counters reset, so only the conversion is measured
+template<class T>
+bool load(const char* json, T& value, size_t& allocated)
+{
+    rapidjson::Document doc;
+    doc.Parse(json);
+    probe::reset();
+    const size_t before = allocations;
+    const bool ok = json_dto::adapter<T>::get(doc, value);
+    allocated = allocations - before;
+    return ok;
+}
+}
+
+int main()
+{
+    size_t allocated = 0;
+
+    std::optional<probe> optional;
+    check(load("1", optional, allocated) && optional->x == 1, "optional loads");
+    check(probe::constructed == 1 && probe::copied == 0 && probe::moved == 0 && allocated == 0, "optional emplaces in place");
+    check(load("2", optional, allocated) && optional->x == 2, "optional reloads");
+    check(probe::constructed == 0 && probe::copied == 0 && probe::moved == 0 && allocated == 0, "optional reuses its value");
+    check(!load("\"x\"", optional, allocated) && !optional, "optional is reset when loading fails");
+
+    std::unique_ptr<probe> unique;
+    check(load("3", unique, allocated) && unique->x == 3, "unique_ptr loads");
+    check(probe::constructed == 1 && probe::copied == 0 && probe::moved == 0 && allocated == 1, "unique_ptr allocates once");
+    check(load("4", unique, allocated) && unique->x == 4, "unique_ptr reloads");
+    check(probe::constructed == 0 && probe::copied == 0 && probe::moved == 0 && allocated == 0, "unique_ptr reuses its object");
+    check(!load("\"x\"", unique, allocated) && !unique, "unique_ptr is reset when loading fails");
+
+    std::shared_ptr<probe> shared;
+    check(load("5", shared, allocated) && shared->x == 5, "shared_ptr loads");
+    check(probe::constructed == 1 && probe::copied == 0 && probe::moved == 0 && allocated == 1, "shared_ptr allocates one block");
+
+    std::variant<int, probe> variant;
+    check(load(R"({"type":1,"value":6})", variant, allocated) && std::get<1>(variant).x == 6, "variant loads");
+    check(probe::constructed == 1 && probe::copied == 0 && probe::moved == 0 && allocated == 0, "variant emplaces in place");
+    check(load(R"({"type":1,"value":7})", variant, allocated) && std::get<1>(variant).x == 7, "variant reloads");
+    check(probe::constructed == 0 && probe::copied == 0 && probe::moved == 0 && allocated == 0, "variant reuses its alternative");
+
+    // Short keys fit into the string's own buffer, so each item costs exactly its node
+    std::map<std::string, probe> map;
+    check(load(R"({"a":1,"b":2,"c":3})", map, allocated) && map.size() == 3 && map["c"].x == 3, "map loads");
+    check(probe::constructed == 3 && probe::copied == 0 && probe::moved == 0 && allocated == 3, "map constructs items in their nodes");
+
+    return failures == 0 ? 0 : 1;
+}
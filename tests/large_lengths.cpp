@@ -0,0 +1,190 @@
+// Lengths over 32 bits. Built twice: with JSON_DTO_64BIT_SIZES they must round trip,
+// without it they must raise std::length_error instead of being truncated.
+// The length checks always run; --large also converts a string over 4 GiB,
+// --file writes files over 4 GiB to the temporary directory and streams them back,
+// --huge converts an array of over 2^32 elements, which needs more than 100 GiB of memory.
+#include <json_dto_files.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+template<class F>
+bool throws_length_error(F&& f)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::length_error&)
+    {
+        return true;
+    }
+    return false;
+}
+
+struct large
+{
+    std::string s;
+    std::vector<int> v;
+
+    void serialization(auto& io)
+    {
+        io("large")("s", s)("v", v);
+    }
+};
+
+constexpr size_t over_32_bits = (size_t{ 1 } << 32) + 3;
+#if defined(JSON_DTO_64BIT_SIZES)
+constexpr bool wide = true;
+#else
+constexpr bool wide = false;
+#endif
+
+void check_sizes()
+{
+    static_assert((sizeof(rapidjson::SizeType) == sizeof(size_t)) == wide);
+    if constexpr (wide)
+        check(json_dto::detail::checked_size(over_32_bits) == over_32_bits, "checked_size keeps 64-bit lengths");
+    else
+        check(throws_length_error([] { json_dto::detail::checked_size(over_32_bits); }), "checked_size rejects 64-bit lengths");
+}
+
+void check_string()
+{
+    large value;
+    value.s.assign(over_32_bits, 'a');
+    value.s.back() = 'z';
+    if constexpr (wide)
+    {
+        const std::string text = json_dto::dumps(value);
+        value = {};
+        check(text.size() > over_32_bits, "string is dumped whole");
+        value = json_dto::loads<large>(text);
+        check(value.s.size() == over_32_bits && value.s.front() == 'a' && value.s.back() == 'z', "string round trips");
+    }
+    else
+        check(throws_length_error([&] { (void)json_dto::dumps(value); }), "dumping a 64-bit string length throws");
+}
+
+void check_array()
+{
+    large value;
+    value.v.assign(over_32_bits, 0);
+    value.v.back() = 7;
+    if constexpr (wide)
+    {
+        const std::string text = json_dto::dumps(value);
+        value = {};
+        value = json_dto::loads<large>(text);
+        check(value.v.size() == over_32_bits && value.v.back() == 7, "array round trips");
+    }
+    else
+        check(throws_length_error([&] { (void)json_dto::dumps(value); }), "dumping a 64-bit array length throws");
+}
+
+// Removes the file when the test is done with it, also after a failure
+class temp_file
+{
+    std::filesystem::path _path;
+public:
+    explicit temp_file(const char* name) :
+        _path(std::filesystem::temp_directory_path() / (std::string(name) + (wide ? "_64" : "_32")))
+    {
+    }
+    temp_file(const temp_file&) = delete;
+    temp_file& operator=(const temp_file&) = delete;
+    ~temp_file() { std::filesystem::remove(_path); }
+    const std::filesystem::path& path() const { return _path; }
+};
+
+// NDJSON of small records over 4 GiB in total: records past the 32-bit offsets are split and loaded from the mapping
+void check_records_file()
+{
+    const temp_file file("json_dto_large_records.ndjson");
+    const std::string padding(1000, 'a');
+    size_t written = 0;
+    size_t count = 0;
+    {
+        std::ofstream out(file.path(), std::ios::binary);
+        while (written <= over_32_bits)
+        {
+            const std::string record = R"({"s":")" + padding + R"(","v":[)" + std::to_string(count++) + "]}\n";
+            out << record;
+            written += record.size();
+        }
+        check(bool(out.flush()), "records file is written");
+    }
+    size_t loaded = 0;
+    size_t sum = 0;
+    const auto ranges = json_dto::partition(file.path(), 7, json_dto::record_format::ndjson);
+    check(!ranges.empty() && ranges.back().end == written, "partition covers a file over 4 GiB");
+    for (const auto& range : ranges)
+    {
+        json_dto::load_range<large>(file.path(), range, [&](large&& value)
+        {
+            if (value.s.size() == padding.size() && value.v.size() == 1)
+            {
+                ++loaded;
+                sum += (size_t)value.v[0];
+            }
+        });
+    }
+    check(loaded == count && sum == count * (count - 1) / 2, "every record of a file over 4 GiB is loaded");
+}
+
+// A single string over 4 GiB, written to a file and read back through an input stream.
+// Only with 64-bit sizes: otherwise rapidjson's reader itself truncates the length it reports.
+void check_string_file()
+{
+    const temp_file file("json_dto_large_string.json");
+    {
+        std::ofstream out(file.path(), std::ios::binary);
+        out << R"({"s":")";
+        const std::string chunk(1 << 20, 'a');
+        size_t left = over_32_bits - 1;
+        for (; left >= chunk.size(); left -= chunk.size())
+            out.write(chunk.data(), (std::streamsize)chunk.size());
+        out.write(chunk.data(), (std::streamsize)left);
+        out << R"(z","v":[]})";
+        check(bool(out.flush()), "string file is written");
+    }
+    std::ifstream in(file.path(), std::ios::binary);
+    large value;
+    json_dto::load(in, value);
+    check(value.s.size() == over_32_bits && value.s.front() == 'a' && value.s.back() == 'z', "string file loads");
+}
+}
+
+int main(int argc, char** argv)
+{
+    check_sizes();
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--large") == 0)
+            check_string();
+        else if (std::strcmp(argv[i], "--file") == 0)
+        {
+            check_records_file();
+            if constexpr (wide)
+                check_string_file();
+        }
+        else if (std::strcmp(argv[i], "--huge") == 0)
+            check_array();
+    }
+    return failures == 0 ? 0 : 1;
+}
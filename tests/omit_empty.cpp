@@ -0,0 +1,84 @@
+// The compact profile: write_options::omit_empty leaves out null and empty members, and only
+// load_options::omit_empty reads them back; by default every member is still required.
+#include <json_dto.h>
+
+#include <cstdio>
+#include <map>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+template<class F>
+bool throws_parse_exception(F&& f)
+{
+    try
+    {
+        f();
+    }
+    catch (const json_dto::parse_exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+struct compact
+{
+    int id = 0;
+    std::vector<int> items;
+    std::map<std::string, int> tags;
+    std::optional<std::string> note;
+
+    void serialization(auto& io)
+    {
+        io("compact")("id", id)("items", items)("tags", tags)("note", note);
+    }
+};
+
+struct only_id
+{
+    int id = 0;
+
+    void serialization(auto& io)
+    {
+        io("only_id")("id", id);
+    }
+};
+}
+
+int main()
+{
+    const json_dto::load_options omit{ .omit_empty = true };
+
+    compact value;
+    value.id = 1;
+    const std::string text = json_dto::dumps(value, json_dto::write_options{ .omit_empty = true });
+    check(text == R"({"id":1})", "null and empty members are left out");
+
+    check(throws_parse_exception([&] { (void)json_dto::loads<compact>(text); }), "a missing vector fails by default");
+    check(json_dto::validate<compact>(text).has_value(), "a missing vector does not validate by default");
+    check(throws_parse_exception([] { (void)json_dto::convert<compact>(only_id{ 1 }); }), "a missing vector does not convert by default");
+
+    value = json_dto::loads<compact>(R"({"id":2,"items":[3],"tags":{"a":4},"note":"n"})");
+    value = json_dto::loads<compact>(text, omit);
+    check(value.id == 1 && value.items.empty() && value.tags.empty() && !value.note, "missing members load as null or empty");
+    check(!json_dto::validate<compact>(text, omit), "missing members validate");
+
+    compact converted;
+    converted.items = { 5 };
+    json_dto::convert(only_id{ 6 }, converted, omit);
+    check(converted.id == 6 && converted.items.empty(), "missing members convert as null or empty");
+
+    check(throws_parse_exception([&] { (void)json_dto::loads<compact>(R"({"items":[]})", omit); }), "other members stay required");
+    return failures == 0 ? 0 : 1;
+}